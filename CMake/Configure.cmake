@@ -27,6 +27,9 @@ if(MPI_FOUND)
   check_function_exists(ompi_comm_free HAVE_OMPI_COMM_FREE)
 endif()
 
+check_function_exists(posix_memalign HAVE_POSIX_MEMALIGN)
+check_function_exists(madvise HAVE_MADVISE)
+
 try_compile(HAVE_CXX_MPI_INIT_THREAD ${PROJECT_BINARY_DIR}/config
   ${PROJECT_SOURCE_DIR}/CMake/config/mpi_init_thread.cpp
   CMAKE_FLAGS "-DINCLUDE_DIRECTORIES:STRING=${MPI_CXX_INCLUDE_PATH}"
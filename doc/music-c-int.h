@@ -64,6 +64,13 @@ void MUSIC_EventInputPort_map (MUSIC_EventInputPort *port,
 			       double accLatency,
 			       int maxBuffered);
 
+/* Sending events */
+
+void MUSIC_EventOutputPort_insertEvents (MUSIC_EventOutputPort *port,
+					 double *t,
+					 int *ids,
+					 size_t n);
+
 void MUSIC_MessageOutputPort_map (MUSIC_MessageOutputPort *port,
 				  int maxBuffered);
 
@@ -125,8 +132,14 @@ MUSIC_Runtime *MUSIC_createRuntime (MUSIC_Setup *setup, double h);
 
 void MUSIC_tick (MUSIC_Runtime *runtime);
 
+void MUSIC_advance (MUSIC_Runtime *runtime, int nTicks);
+
+void MUSIC_tickUntil (MUSIC_Runtime *runtime, double t);
+
 double MUSIC_time (MUSIC_Runtime *runtime);
 
+double MUSIC_nextCommunicationTime (MUSIC_Runtime *runtime);
+
 /* Finalization */
 
 void MUSIC_destroyRuntime (MUSIC_Runtime *runtime);
@@ -2,7 +2,7 @@ import sys
 
 cdef extern from "music/port.hh":
     ctypedef struct cxx_EventOutputPort "MUSIC::EventOutputPort":
-        pass
+        void insertEvents (double* t, int* id, size_t n)
     ctypedef struct cxx_EventInputPort "MUSIC::EventInputPort":
         pass
 
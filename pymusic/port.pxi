@@ -1,5 +1,7 @@
 import sys
 
+from libc.stdlib cimport malloc, free
+
 from port cimport *
 
 cdef class EventOutputPort:
@@ -7,6 +9,22 @@ cdef class EventOutputPort:
     def __cinit__(self):
         pass
 
+    def insertEvents (self, times, ids):
+        cdef size_t n = len (times)
+        if len (ids) != n:
+            raise ValueError ("times and ids differ in length")
+        cdef double* t = <double*> malloc (n * sizeof (double))
+        cdef int* id = <int*> malloc (n * sizeof (int))
+        cdef size_t i
+        try:
+            for i in range (n):
+                t[i] = times[i]
+                id[i] = ids[i]
+            self.cxx.insertEvents (t, id, n)
+        finally:
+            free (t)
+            free (id)
+
 cdef wrapEventOutputPort (cxx_EventOutputPort* port):
     cdef EventOutputPort port_ = EventOutputPort ()
     port_.cxx = port
@@ -7,8 +7,14 @@ cdef extern from "music/runtime.hh":
         
         void tick ()
         
+        void advance (int nTicks)
+        
+        void tickUntil (double t)
+        
         double time ()
         
+        double nextCommunicationTime ()
+        
         void finalize ()
         
     cxx_Runtime *new_Runtime "new MUSIC::Runtime" (cxx_Setup* s, double h)
@@ -17,9 +17,18 @@ cdef class Runtime:
     def tick (self):
         self.cxx.tick ()
 
+    def advance (self, nTicks):
+        self.cxx.advance (nTicks)
+
+    def tickUntil (self, t):
+        self.cxx.tickUntil (t)
+
     def time (self):
         return self.cxx.time ()
 
+    def nextCommunicationTime (self):
+        return self.cxx.nextCommunicationTime ()
+
     def finalize (self):
         self.cxx.finalize ()
 
@@ -20,6 +20,7 @@
 #include "music/debug.hh"
 
 #include <cstring>
+#include <algorithm>
 
 #include "music/error.hh"
 
@@ -27,13 +28,29 @@
 
 namespace MUSIC {
 
+  // The buffer is a ring of blocks (a "bipartite buffer"): blocks
+  // are inserted above the unread data until there is no room for a
+  // maximal block, after which insertion wraps around to the bottom
+  // of the buffer.  With room for the unread data plus two maximal
+  // blocks, a maximal block always fits either above the unread data
+  // or below it, so buffered data never has to be moved.
+
+  int
+  BIFO::capacity (int nBuffered)
+  {
+    return nBuffered + 2 * maxBlockSize_ + elementSize_;
+  }
+
+  
   void
   BIFO::configure (int elementSize, int maxBlockSize)
   {
     MUSIC_LOGR ("BIFO::configure (" << elementSize << ", " << maxBlockSize << ")");
     elementSize_ = elementSize;
     maxBlockSize_ = maxBlockSize;
-    size = maxBlockSize_;
+    // At most one maximal block is normally buffered when a new
+    // block is received
+    size = capacity (maxBlockSize_);
     buffer.resize (size);
     beginning = 0;
     end = 0;
@@ -47,13 +64,13 @@ namespace MUSIC {
   void
   BIFO::fill (int nElements)
   {
-    int neededSize = nElements * elementSize_;
-    if (neededSize > size)
-      grow (neededSize);
-    
     if (end - current != elementSize_)
       error ("internal error: BIFO in erroneous state before fill");
     
+    int neededSize = capacity (nElements * elementSize_);
+    if (neededSize > size)
+      grow (neededSize);
+    
     beginning = 0;
     
     if (nElements == 0)
@@ -76,6 +93,7 @@ namespace MUSIC {
     
     top = elementSize_;
     end = nElements * elementSize_;
+    highWater_ = std::max (highWater_, end);
     while (top < end)
       {
 	memcpy (&buffer[top], &buffer[0], elementSize_);
@@ -94,43 +112,36 @@ namespace MUSIC {
   void*
   BIFO::insertBlock ()
   {
+    if (current == end)
+      {
+	// The buffer is empty---start over at the bottom
+	current = 0;
+	end = 0;
+	top = 0;
+      }
     beginning = end; // set insertion point to end of last block
     if (current <= end) // reading below inserting?
       {
 	// Inserting above current data
 
-
-	// Is it time to wrap around the insertion point?  This should
-	// only be done if we can fit a maximal block below current
-	// (current > maxBlockSize_).  We need to use > since a
-	// maximal block otherwise could cause an empty buffer.
-	if (current > maxBlockSize_)
-	  beginning = 0; // Wrap around!
-	else if (beginning + maxBlockSize_ > size) // Need to enlarge?
-	  // (The peculiar choice of growing just as much as we need
-	  // is made since buffers can be VERY large in large scale
-	  // simulations.)
-	  grow (beginning + maxBlockSize_);
+	// Wrap around the insertion point when a maximal block does
+	// not fit above current data.  This can only be done if we
+	// can fit a maximal block below current (current >
+	// maxBlockSize_).  We need to use > since a maximal block
+	// otherwise could cause an empty buffer.
+	if (beginning + maxBlockSize_ > size)
+	  {
+	    if (current > maxBlockSize_)
+	      beginning = 0; // Wrap around!
+	    else
+	      grow (capacity (end - current));
+	  }
       }
     else
       {
 	// Inserting below current data
 	if (current - beginning <= maxBlockSize_) // Too tight?
-	  {
-	    // delta is how much more space we need + epsilon (8 to be
-	    // nice to memory)
-	    int delta = maxBlockSize_ - (current - beginning) + 8;
-	    if (size - top < delta) // Need to enlarge?
-	    // (The peculiar choice of growing just as much as we need
-	    // is made since buffers can be VERY large in large scale
-	    // simulations.)
-	      grow (size + delta);
-	    // Now move entire upper chunk of data:
-	    memmove (&buffer[current + delta], &buffer[current],
-		     top - current);
-	    current += delta;
-	    top += delta;
-	  }
+	  grow (capacity (top - current + end));
       }
     MUSIC_LOGR ("BIFO::insertBlock () -> beg = " << beginning << ", end = " << end << ", cur = " << current << ", top = " << top << ", size = " << size)
     return static_cast<void*> (&buffer[beginning]);
@@ -154,6 +165,10 @@ namespace MUSIC {
 	  }
 	if (current <= end)
 	  top = end;
+	int buffered = (current <= end
+			? end - current
+			: top - current + end);
+	highWater_ = std::max (highWater_, buffered);
       }
     MUSIC_LOGR ("BIFO::trimBlock () -> beg = " << beginning << ", end = " << end << ", cur = " << current << ", top = " << top << ", size = " << size)
   }
@@ -184,11 +199,32 @@ namespace MUSIC {
     return memory;
   }
 
+  // Only needed if more data than expected is buffered.  Moves the
+  // unread data to the bottom of a larger buffer and sets the
+  // insertion point after it.
   void
   BIFO::grow (int newSize)
   {
-    size = newSize;
-    buffer.resize (size);
+    MUSIC_LOGR ("BIFO::grow (" << newSize << ")");
+    std::vector<char> newBuffer (std::max (newSize, size));
+    int n = 0;
+    if (current <= end)
+      {
+	memcpy (&newBuffer[0], &buffer[current], end - current);
+	n = end - current;
+      }
+    else
+      {
+	memcpy (&newBuffer[0], &buffer[current], top - current);
+	memcpy (&newBuffer[top - current], &buffer[0], end);
+	n = top - current + end;
+      }
+    buffer.swap (newBuffer);
+    size = buffer.size ();
+    current = 0;
+    beginning = n;
+    end = n;
+    top = n;
   }
     
 }
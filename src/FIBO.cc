@@ -19,26 +19,62 @@
 //#define MUSIC_DEBUG 1
 #include "music/debug.hh"
 
+#include "config.h"
+
+#include <cstdlib>
 #include <cstring>
+#include <climits>
+#include <algorithm>
+
+#ifdef HAVE_MADVISE
+#include <sys/mman.h>
+#endif
+
+#include "music/error.hh"
 
 #include "music/FIBO.hh"
 
 namespace MUSIC {
 
+  // Buffers of at least this size are aligned to huge pages
+  static const int HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  bool FIBO::hugePages_ = false;
+
+  
+  FIBO::FIBO ()
+    : buffer (NULL), spare (NULL), spareSize (0), elementSize (0), size (0),
+      current (0), highWater_ (0)
+  {
+  }
+
+  
   FIBO::FIBO (int es)
+    : buffer (NULL), spare (NULL), spareSize (0), elementSize (0), size (0),
+      current (0), highWater_ (0)
   {
     if (es > 0)
       configure (es);
   }
 
+
+  FIBO::~FIBO ()
+  {
+    free (buffer);
+    free (spare);
+  }
+
   
   void
-  FIBO::configure (int es)
+  FIBO::configure (int es, int capacityHint)
   {
-    MUSIC_LOGR ("FIBO::configure (" << es << ")");
+    MUSIC_LOGR ("FIBO::configure (" << es << ", " << capacityHint << ")");
     elementSize = es;
-    size = elementSize * nInitial;
-    buffer.resize (size);
+    int newSize = elementSize * std::max (capacityHint, nInitial);
+    newSize = std::max (newSize, minInitialSize);
+    free (buffer);
+    buffer = allocate (newSize);
+    size = newSize;
     current = 0;
   }
 
@@ -53,12 +89,9 @@ namespace MUSIC {
   void*
   FIBO::insert ()
   {
-    if (current == size)
-      grow (2 * size);
-    // Here we use the assumption that vector memory is contiguous
-    // Josuttis says this is the intention of STL even though the
-    // first version of the report is not clear about this.
-    void* memory = static_cast<void*> (&buffer[current]);
+    if (current + elementSize > size)
+      grow (current + elementSize);
+    void* memory = static_cast<void*> (buffer + current);
     current += elementSize;
     return memory;
   }
@@ -69,16 +102,29 @@ namespace MUSIC {
   {
     int blockSize = elementSize * n_elements;
     if (current + blockSize > size)
-      grow (3 * (current + blockSize) / 2);
-    // Here we use the assumption that vector memory is contiguous
-    // Josuttis says this is the intention of STL even though the
-    // first version of the report is not clear about this.
-    void* memory = static_cast<void*> (&buffer[current]);
+      grow (current + blockSize);
+    void* memory = static_cast<void*> (buffer + current);
     memcpy (memory, elements, blockSize);
     current += blockSize;
   }
 
 
+  void*
+  FIBO::insertBlock (int maxBlockSize)
+  {
+    if (current + maxBlockSize > size)
+      grow (current + maxBlockSize);
+    return static_cast<void*> (buffer + current);
+  }
+
+
+  void
+  FIBO::trimBlock (int blockSize)
+  {
+    current += blockSize;
+  }
+
+
   void
   FIBO::clear ()
   {
@@ -86,11 +132,20 @@ namespace MUSIC {
   }
   
 
+  void
+  FIBO::discard (int nBytes)
+  {
+    memmove (buffer, buffer + nBytes, current - nBytes);
+    current -= nBytes;
+  }
+  
+
   void
   FIBO::nextBlockNoClear (void*& data, int& blockSize)
   {
-    data = static_cast<void*> (&buffer[0]);
+    data = static_cast<void*> (buffer);
     blockSize = current;
+    highWater_ = std::max (highWater_, current);
   }
 
 
@@ -103,10 +158,63 @@ namespace MUSIC {
 
 
   void
-  FIBO::grow (int newSize)
+  FIBO::swapBlock (void*& data, int& blockSize)
   {
+    std::swap (buffer, spare);
+    std::swap (size, spareSize);
+    data = static_cast<void*> (spare);
+    blockSize = current;
+    highWater_ = std::max (highWater_, current);
+    current = 0;
+    // Keep both buffers at the high-water mark.  The new insertion
+    // buffer is empty, so it can be replaced without copying.
+    if (size < spareSize)
+      {
+	free (buffer);
+	size = spareSize;
+	buffer = allocate (size);
+      }
+  }
+
+
+  // Grow geometrically to at least minSize.  Only the part of the
+  // buffer which is in use is copied.
+  void
+  FIBO::grow (int minSize)
+  {
+    long long doubled = 2LL * size;
+    if (doubled > INT_MAX)
+      error ("FIBO: buffer size overflow");
+    int newSize = std::max (minSize, static_cast<int> (doubled));
+    char* newBuffer = allocate (newSize);
+    memcpy (newBuffer, buffer, current);
+    free (buffer);
+    buffer = newBuffer;
     size = newSize;
-    buffer.resize (size);
   }
-  
+
+
+  // Allocate uninitialized memory.  nBytes may be rounded up.
+  char*
+  FIBO::allocate (int& nBytes)
+  {
+    void* memory = NULL;
+#ifdef HAVE_POSIX_MEMALIGN
+    if (hugePages_ && nBytes >= HUGE_PAGE_SIZE)
+      {
+	nBytes = (nBytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	if (posix_memalign (&memory, HUGE_PAGE_SIZE, nBytes) != 0)
+	  error ("FIBO: out of memory");
+#if defined (HAVE_MADVISE) && defined (MADV_HUGEPAGE)
+	madvise (memory, nBytes, MADV_HUGEPAGE);
+#endif
+	return static_cast<char*> (memory);
+      }
+#endif
+    memory = malloc (std::max (nBytes, 1));
+    if (memory == NULL)
+      error ("FIBO: out of memory");
+    return static_cast<char*> (memory);
+  }
+    
 }
@@ -53,9 +53,8 @@ namespace MUSIC {
       = new IntervalTree<int, IndexInterval> ();
     
     IndexMap* indices = dataMap->indexMap ();
-    for (IndexMap::iterator i = indices->begin ();
-	 i != indices->end ();
-	 ++i)
+    const IndexInterval* end = indices->data () + indices->size ();
+    for (const IndexInterval* i = indices->data (); i != end; ++i)
       {
 	MUSIC_LOGR ("adding (" << i->begin () << ", " << i->end ()
 		    << ", " << i->local () << ") to tree");
@@ -102,7 +101,7 @@ namespace MUSIC {
 	Intervals& intervals = b->second;
 	sort (intervals.begin (), intervals.end ());
 	int elementSize = dataMap->type ().Get_size ();
-	int size = 0;
+	CopyPlan plan;
 	for (Intervals::iterator i = intervals.begin ();
 	     i != intervals.end ();
 	     ++i)
@@ -110,35 +109,29 @@ namespace MUSIC {
 	    IntervalCalculator calculator (*i, elementSize);
 	    MUSIC_LOGX ("searching for " << i->begin ());
 	    tree->search (i->begin (), &calculator);
-	    size += i->length ();
+	    plan.addRun (i->begin (), i->length ());
 	  }
+	MUSIC_LOGX ("copy plan: " << intervals.size () << " intervals in "
+		    << plan.nSegments () << " segments");
+	int size = plan.size ();
 	buffer->configure (size, size * allowedBuffered_);
+	plans.push_back (std::make_pair (buffer, plan));
       }
+
+    delete tree;
   }
 
 
   void
   Collector::collect (ContDataT* base)
   {
-    for (BufferMap::iterator b = buffers.begin (); b != buffers.end (); ++b)
+    for (Plans::iterator p = plans.begin (); p != plans.end (); ++p)
       {
-	BIFO* buffer = b->first;
-	Intervals& intervals = b->second;
-	ContDataT* src = static_cast<ContDataT*> (buffer->next ());
+	ContDataT* src = static_cast<ContDataT*> (p->first->next ());
 	if (src == NULL)
 	  // Out of data (remote has flushed)
 	  return;
-	ContDataT* dest = static_cast<ContDataT*> (base);
-	for (Intervals::iterator i = intervals.begin ();
-	     i != intervals.end ();
-	     ++i)
-	  {
-	    MUSIC_LOGX ("collect to dest = " << static_cast<void*> (dest)
-		       << ", begin = " << i->begin ()
-		       << ", length = " << i->length ());
-	    memcpy (dest + i->begin (), src, i->length ());
-	    dest += i->length ();
-	  }
+	p->second.scatter (base, src);
       }
   }
 
@@ -34,7 +34,8 @@ namespace MUSIC {
 			MPI::Intracomm c)
     : info (info_),
       spatialNegotiator_ (spatialNegotiator),
-      comm (c)
+      comm (c),
+      protocol_ (0)
   {
   }
 
@@ -46,7 +47,8 @@ namespace MUSIC {
     : info (info_),
       spatialNegotiator_ (spatialNegotiator),
       comm (c),
-      intercomm (ic)
+      intercomm (ic),
+      protocol_ (0)
   {
   }
 
@@ -75,6 +77,24 @@ namespace MUSIC {
   }
 
 
+  // Agree with the remote connector on optional protocol features.
+  // We keep the features enabled on both sides.
+  void
+  Connector::negotiateProtocol (int protocol)
+  {
+    if (isLeader ())
+      {
+	int remoteProtocol = protocol;
+	intercomm.Sendrecv_replace (&remoteProtocol, 1, MPI::INT,
+				    0, PROTOCOL_MSG,
+				    0, PROTOCOL_MSG);
+	protocol &= remoteProtocol;
+      }
+    comm.Bcast (&protocol, 1, MPI::INT, 0);
+    protocol_ = protocol;
+  }
+
+
   void
   OutputConnector::spatialNegotiation
   (std::vector<OutputSubconnector*>& osubconn,
@@ -97,6 +117,7 @@ namespace MUSIC {
 	else
 	  {
 	    subconn = makeOutputSubconnector (i->rank ());
+	    subconn->setProtocol (protocol_);
 	    subconnectors.insert (std::make_pair (i->rank (), subconn));
 	    osubconn.push_back (subconn);
 	  }
@@ -142,6 +163,7 @@ namespace MUSIC {
 	else
 	  {
 	    subconn = makeInputSubconnector (i->rank (), receiverRank);
+	    subconn->setProtocol (protocol_);
 	    subconnectors.insert (std::make_pair (i->rank (), subconn));
 	    isubconn.push_back (subconn);
 	  }
@@ -199,12 +221,15 @@ namespace MUSIC {
   OutputSubconnector*
   ContOutputConnector::makeOutputSubconnector (int remoteRank)
   {
-    return new ContOutputSubconnector (synchronizer (),
-				       intercomm,
-				       remoteLeader (),
-				       remoteRank,
-				       receiverPortCode (),
-				       type_);
+    ContOutputSubconnector* subconn
+      = new ContOutputSubconnector (synchronizer (),
+				    intercomm,
+				    remoteLeader (),
+				    remoteRank,
+				    receiverPortCode (),
+				    type_);
+    subconnectors_.push_back (subconn);
+    return subconn;
   }
   
 
@@ -243,8 +268,16 @@ namespace MUSIC {
   void
   PlainContOutputConnector::initialize ()
   {
-    distributor_.configure (sampler_.dataMap ());
+    distributor_.configure (sampler_.dataMap (), synch.allowedBuffered () + 1);
+    if (zeroCopy_)
+      distributor_.setDirect ();
     distributor_.initialize ();
+    if (zeroCopy_)
+      for (std::vector<ContOutputSubconnector*>::iterator s
+	     = subconnectors_.begin ();
+	   s != subconnectors_.end ();
+	   ++s)
+	(*s)->setDirect (distributor_.plan ((*s)->buffer ()));
     synch.initialize ();
 
     // put one element in send buffers
@@ -258,7 +291,9 @@ namespace MUSIC {
     if (synch.sample ())
       {
 	// copy application data to send buffers
+	double start = MPI::Wtime ();
 	distributor_.distribute ();
+	copyTime_ += MPI::Wtime () - start;
       }
 
     synch.tick ();
@@ -269,6 +304,17 @@ namespace MUSIC {
   }
 
 
+  // Samples which were not sent directly from application memory
+  // are copied to the send buffers before the application resumes.
+  void
+  PlainContOutputConnector::postCommunication ()
+  {
+    double start = MPI::Wtime ();
+    distributor_.storePending ();
+    copyTime_ += MPI::Wtime () - start;
+  }
+
+
   InterpolatingContOutputConnector::InterpolatingContOutputConnector
   (ContOutputConnector& connector)
     : Connector (connector),
@@ -280,7 +326,8 @@ namespace MUSIC {
   void
   InterpolatingContOutputConnector::initialize ()
   {
-    distributor_.configure (sampler_.interpolationDataMap ());
+    distributor_.configure (sampler_.interpolationDataMap (),
+			    synch.allowedBuffered () + 1);
     distributor_.initialize ();
     synch.initialize ();
 
@@ -294,6 +341,7 @@ namespace MUSIC {
   void
   InterpolatingContOutputConnector::tick (bool& requestCommunication)
   {
+    double start = MPI::Wtime ();
     synch.tick ();
     if (synch.sample ())
       // sampling before and after time of receiver tick
@@ -304,6 +352,7 @@ namespace MUSIC {
 	synch.remoteTick ();
 	distributor_.distribute ();
       }
+    copyTime_ += MPI::Wtime () - start;
     if (synch.communicate ())
       requestCommunication = true;
   }
@@ -399,7 +448,15 @@ namespace MUSIC {
   PlainContInputConnector::postCommunication ()
   {
     // collect data from input buffers and write to application
+    //
+    // The data can't be received directly into the application
+    // array: the synchronizer schedules receives at least one tick
+    // ahead of the sample being written, and each message carries
+    // samples for at least two sender ticks, so received data must
+    // be staged in the BIFO even when initialBufferedTicks () is 0.
+    double start = MPI::Wtime ();
     collector_.collect ();
+    copyTime_ += MPI::Wtime () - start;
   }
 
 
@@ -434,6 +491,7 @@ namespace MUSIC {
   void
   InterpolatingContInputConnector::postCommunication ()
   {
+    double start = MPI::Wtime ();
     if (first_)
       {
 	collector_.collect (sampler_.insert ());
@@ -446,6 +504,7 @@ namespace MUSIC {
 	synch.remoteTick ();
       }
     sampler_.interpolateToApplication (synch.interpolationCoefficient ());
+    copyTime_ += MPI::Wtime () - start;
   }
 
 
@@ -505,10 +564,12 @@ namespace MUSIC {
 					    SpatialInputNegotiator* spatialNegotiator,
 					    EventHandlerPtr handleEvent,
 					    Index::Type type,
-					    MPI::Intracomm comm)
+					    MPI::Intracomm comm,
+					    FIBO* events)
     : Connector (connInfo, spatialNegotiator, comm),
       handleEvent_ (handleEvent),
-      type_ (type)
+      type_ (type),
+      events_ (events)
   {
   }
 
@@ -523,7 +584,15 @@ namespace MUSIC {
   InputSubconnector*
   EventInputConnector::makeInputSubconnector (int remoteRank, int receiverRank)
   {
-    if (type_ == Index::GLOBAL)
+    if (events_ != NULL)
+      return new EventInputSubconnectorBuffer (&synch,
+					       intercomm,
+					       remoteLeader (),
+					       remoteRank,
+					       receiverRank,
+					       receiverPortCode (),
+					       events_);
+    else if (type_ == Index::GLOBAL)
       return new EventInputSubconnectorGlobal (&synch,
 					       intercomm,
 					       remoteLeader (),
@@ -561,11 +630,9 @@ namespace MUSIC {
 						  SpatialOutputNegotiator*
 						  spatialNegotiator,
 						  MPI::Intracomm comm,
-						  std::vector<FIBO*>& buffers)
+						  MessageLog* log)
     : Connector (connInfo, spatialNegotiator, comm),
-      buffer (1),
-      bufferAdded (false),
-      buffers_ (buffers)
+      log_ (log)
   {
   }
 
@@ -585,19 +652,7 @@ namespace MUSIC {
 					  remoteLeader (),
 					  remoteRank,
 					  receiverPortCode (),
-					  &buffer);
-  }
-
-
-  void
-  MessageOutputConnector::addRoutingInterval (IndexInterval,
-					      OutputSubconnector*)
-  {
-    if (!bufferAdded)
-      {
-	buffers_.push_back (&buffer);
-	bufferAdded = true;
-      }
+					  log_);
   }
   
   
@@ -609,15 +664,6 @@ namespace MUSIC {
     if (synch.communicate ())
       requestCommunication = true;
   }
-
-  
-  void
-  MessageOutputConnector::postCommunication ()
-  {
-    if (synch.communicate ())
-      buffer.clear ();
-  }
-
   
   MessageInputConnector::MessageInputConnector (ConnectorInfo connInfo,
 						SpatialInputNegotiator* spatialNegotiator,
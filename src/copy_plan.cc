@@ -0,0 +1,169 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "music/copy_plan.hh"
+
+#include <cstring>
+
+namespace MUSIC {
+
+  void
+  CopyPlan::addRun (int begin, int length)
+  {
+    if (length == 0)
+      return;
+    size_ += length;
+    if (!segments_.empty ())
+      {
+	Segment& last = segments_.back ();
+	int lastBegin = last.begin + (last.count - 1) * last.stride;
+	if (last.count == 1)
+	  {
+	    if (begin == lastBegin + last.length)
+	      {
+		// Adjacent in both buffer and application array
+		last.length += length;
+		return;
+	      }
+	    if (length == last.length)
+	      {
+		last.stride = begin - lastBegin;
+		last.count = 2;
+		return;
+	      }
+	  }
+	else if (length == last.length && begin == lastBegin + last.stride)
+	  {
+	    ++last.count;
+	    return;
+	  }
+      }
+    Segment s = { begin, length, 0, 1 };
+    segments_.push_back (s);
+  }
+
+
+  // The constant size passed to memcpy lets the compiler turn each
+  // copy into plain loads and stores.
+
+  template<int N>
+  static inline void
+  gatherRuns (ContDataT* dest, const ContDataT* src, int stride, int count)
+  {
+    for (int k = 0; k < count; ++k, dest += N, src += stride)
+      memcpy (dest, src, N);
+  }
+
+
+  template<int N>
+  static inline void
+  scatterRuns (ContDataT* dest, const ContDataT* src, int stride, int count)
+  {
+    for (int k = 0; k < count; ++k, dest += stride, src += N)
+      memcpy (dest, src, N);
+  }
+
+
+  void
+  CopyPlan::gather (ContDataT* dest, const ContDataT* src) const
+  {
+    for (std::vector<Segment>::const_iterator s = segments_.begin ();
+	 s != segments_.end ();
+	 ++s)
+      {
+	const ContDataT* from = src + s->begin;
+	if (s->count == 1)
+	  memcpy (dest, from, s->length);
+	else
+	  switch (s->length)
+	    {
+	    case 4:
+	      gatherRuns<4> (dest, from, s->stride, s->count);
+	      break;
+	    case 8:
+	      gatherRuns<8> (dest, from, s->stride, s->count);
+	      break;
+	    case 16:
+	      gatherRuns<16> (dest, from, s->stride, s->count);
+	      break;
+	    default:
+	      for (int k = 0; k < s->count; ++k)
+		memcpy (dest + k * s->length,
+			from + k * s->stride,
+			s->length);
+	    }
+	dest += s->count * s->length;
+      }
+  }
+
+
+  void
+  CopyPlan::scatter (ContDataT* dest, const ContDataT* src) const
+  {
+    for (std::vector<Segment>::const_iterator s = segments_.begin ();
+	 s != segments_.end ();
+	 ++s)
+      {
+	ContDataT* to = dest + s->begin;
+	if (s->count == 1)
+	  memcpy (to, src, s->length);
+	else
+	  switch (s->length)
+	    {
+	    case 4:
+	      scatterRuns<4> (to, src, s->stride, s->count);
+	      break;
+	    case 8:
+	      scatterRuns<8> (to, src, s->stride, s->count);
+	      break;
+	    case 16:
+	      scatterRuns<16> (to, src, s->stride, s->count);
+	      break;
+	    default:
+	      for (int k = 0; k < s->count; ++k)
+		memcpy (to + k * s->stride,
+			src + k * s->length,
+			s->length);
+	    }
+	src += s->count * s->length;
+      }
+  }
+
+
+  MPI::Datatype
+  CopyPlan::datatype (MPI::Datatype type) const
+  {
+    int elementSize = type.Get_size ();
+    std::vector<int> lengths;
+    std::vector<int> displacements;
+    for (std::vector<Segment>::const_iterator s = segments_.begin ();
+	 s != segments_.end ();
+	 ++s)
+      for (int k = 0; k < s->count; ++k)
+	{
+	  lengths.push_back (s->length / elementSize);
+	  displacements.push_back ((s->begin + k * s->stride) / elementSize);
+	}
+    MPI::Datatype indexed = type.Create_indexed (lengths.size (),
+						 &lengths[0],
+						 &displacements[0]);
+    indexed.Commit ();
+    return indexed;
+  }
+
+}
@@ -39,9 +39,10 @@ namespace MUSIC {
   
 
   void
-  Distributor::configure (DataMap* dmap)
+  Distributor::configure (DataMap* dmap, int allowedBuffered)
   {
     dataMap = dmap;
+    allowedBuffered_ = allowedBuffered;
   }
 
   
@@ -52,9 +53,8 @@ namespace MUSIC {
       = new IntervalTree<int, IndexInterval> ();
     
     IndexMap* indices = dataMap->indexMap ();
-    for (IndexMap::iterator i = indices->begin ();
-	 i != indices->end ();
-	 ++i)
+    const IndexInterval* end = indices->data () + indices->size ();
+    for (const IndexInterval* i = indices->data (); i != end; ++i)
       {
 	MUSIC_LOGR ("adding (" << i->begin () << ", " << i->end ()
 		    << ", " << i->local () << ") to tree");
@@ -101,16 +101,22 @@ namespace MUSIC {
 	Intervals& intervals = b->second;
 	sort (intervals.begin (), intervals.end ());
 	int elementSize = dataMap->type ().Get_size ();
-	int size = 0;
+	CopyPlan plan;
 	for (Intervals::iterator i = intervals.begin ();
 	     i != intervals.end ();
 	     ++i)
 	  {
 	    IntervalCalculator calculator (*i, elementSize);
 	    tree->search (i->begin (), &calculator);
-	    size += i->length ();
+	    plan.addRun (i->begin (), i->length ());
 	  }
-	buffer->configure (size);
+	MUSIC_LOGR ("copy plan: " << intervals.size () << " intervals in "
+		    << plan.nSegments () << " segments");
+	buffer->configure (plan.size (), allowedBuffered_);
+	plans.push_back (Plan (buffer));
+	plans.back ().copy = plan;
+	if (direct_ && plan.size () > 0)
+	  plans.back ().type = plan.datatype (dataMap->type ());
       }
 
     delete tree;
@@ -120,23 +126,66 @@ namespace MUSIC {
   void
   Distributor::distribute ()
   {
-    for (BufferMap::iterator b = buffers.begin (); b != buffers.end (); ++b)
+    ContDataT* src = static_cast<ContDataT*> (dataMap->base ());
+    if (direct_)
       {
-	FIBO* buffer = b->first;
-	Intervals& intervals = b->second;
-	ContDataT* src = static_cast<ContDataT*> (dataMap->base ());
-	ContDataT* dest = static_cast<ContDataT*> (buffer->insert ());
-	for (Intervals::iterator i = intervals.begin ();
-	     i != intervals.end ();
-	     ++i)
+	for (Plans::iterator p = plans.begin (); p != plans.end (); ++p)
 	  {
-	    MUSIC_LOGR ("src = " << static_cast<void*> (src)
-		       << ", begin = " << i->begin ()
-		       << ", length = " << i->length ());
-	    memcpy (dest, src + i->begin (), i->length ());
-	    dest += i->length ();
+	    p->store ();
+	    p->base = src;
+	    p->pending = true;
 	  }
+	return;
+      }
+    for (Plans::iterator p = plans.begin (); p != plans.end (); ++p)
+      {
+	ContDataT* dest = static_cast<ContDataT*> (p->buffer->insert ());
+	p->copy.gather (dest, src);
+      }
+  }
+
+
+  // The application may not modify its data before the next tick so
+  // a pending sample can be stored any time before that.
+  void
+  Distributor::Plan::store ()
+  {
+    if (pending)
+      {
+	copy.gather (static_cast<ContDataT*> (buffer->insert ()), base);
+	pending = false;
       }
   }
+
+
+  void
+  Distributor::storePending ()
+  {
+    if (direct_)
+      for (Plans::iterator p = plans.begin (); p != plans.end (); ++p)
+	p->store ();
+  }
+
+
+  Distributor::Plan*
+  Distributor::plan (FIBO* buffer)
+  {
+    for (Plans::iterator p = plans.begin (); p != plans.end (); ++p)
+      if (p->buffer == buffer)
+	return &*p;
+    return NULL;
+  }
+
+
+  void
+  Distributor::freeDatatypes ()
+  {
+    for (Plans::iterator p = plans.begin (); p != plans.end (); ++p)
+      if (p->type != MPI::DATATYPE_NULL)
+	{
+	  p->type.Free ();
+	  p->type = MPI::DATATYPE_NULL;
+	}
+  }
   
 }
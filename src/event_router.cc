@@ -19,6 +19,8 @@
 //#define MUSIC_DEBUG 1
 #include "music/debug.hh"
 
+#include <algorithm>
+
 #include "music/event_router.hh"
 #include "music/event.hh"
 
@@ -27,21 +29,131 @@ namespace MUSIC {
   void
   EventRouter::insertRoutingInterval (IndexInterval i, FIBO* b)
   {
-    routingTable.add (EventRoutingData (i, b));
+    routingIntervals.push_back (EventRoutingData (i, b));
   }
   
 
   void
   EventRouter::buildTable ()
   {
-    MUSIC_LOG0 ("Routing table size for rank 0 = " << routingTable.size ());
+    std::vector<EventRoutingData>::iterator i;
+    for (i = routingIntervals.begin (); i != routingIntervals.end (); ++i)
+      staging[i->buffer ()];
+
+    flat = buildFlatTable ();
+    if (flat)
+      {
+	MUSIC_LOG0 ("Flat routing table size for rank 0 = "
+		    << flatIntervals.size ()
+		    << (table.empty () ? "" : " (direct lookup)"));
+	return;
+      }
+
+    for (i = routingIntervals.begin (); i != routingIntervals.end (); ++i)
+      routingTable.add (*i);
     routingTable.build ();
+    MUSIC_LOG0 ("Routing table size for rank 0 = " << routingTable.size ());
+  }
+
+
+  static bool
+  lessBegin (const EventRoutingData& r1, const EventRoutingData& r2)
+  {
+    return r1.begin () < r2.begin ();
+  }
+
+
+  // Returns false if some routing intervals overlap
+  bool
+  EventRouter::buildFlatTable ()
+  {
+    std::vector<EventRoutingData> intervals;
+    std::vector<EventRoutingData>::iterator i;
+    for (i = routingIntervals.begin (); i != routingIntervals.end (); ++i)
+      if (i->begin () < i->end ())
+	intervals.push_back (*i);
+    sort (intervals.begin (), intervals.end (), lessBegin);
+
+    double covered = 0.0;
+    for (i = intervals.begin (); i != intervals.end (); ++i)
+      {
+	if (i != intervals.begin () && i->begin () < (i - 1)->end ())
+	  return false;
+	covered += i->end () - i->begin ();
+      }
+
+    flatIntervals = intervals;
+    for (i = flatIntervals.begin (); i != flatIntervals.end (); ++i)
+      {
+	flatBegins.push_back (i->begin ());
+	flatStaging.push_back (&staging[i->buffer ()]);
+      }
+
+    if (flatIntervals.empty ())
+      return true;
+    
+    // Use direct lookup if at least half of the range is covered
+    tableBase = flatIntervals.front ().begin ();
+    double range = (double) flatIntervals.back ().end () - tableBase;
+    if (range <= 2 * covered)
+      {
+	table.assign ((size_t) range, -1);
+	for (unsigned int r = 0; r < flatIntervals.size (); ++r)
+	  for (int id = flatIntervals[r].begin ();
+	       id < flatIntervals[r].end ();
+	       ++id)
+	    table[id - tableBase] = r;
+      }
+    return true;
+  }
+
+
+  // Returns the position of the routing interval containing id in
+  // flatIntervals, or -1 if there is none
+  int
+  EventRouter::findInterval (int id) const
+  {
+    if (!table.empty ())
+      {
+	// negative differences wrap around to large values
+	unsigned int i = (unsigned int) id - (unsigned int) tableBase;
+	return i < table.size () ? table[i] : -1;
+      }
+
+    size_t n = flatBegins.size ();
+    if (n == 0 || id < flatBegins[0])
+      return -1;
+    // Branch-free binary search for the last interval beginning at
+    // or before id
+    const int* base = &flatBegins[0];
+    while (n > 1)
+      {
+	size_t half = n / 2;
+	base = base[half] <= id ? base + half : base;
+	n -= half;
+      }
+    int r = base - &flatBegins[0];
+    return id < flatIntervals[r].end () ? r : -1;
+  }
+
+
+  void
+  EventRouter::insertFlat (double t, int id)
+  {
+    int r = findInterval (id);
+    if (r >= 0)
+      flatIntervals[r].insert (t, id - flatIntervals[r].offset ());
   }
 
 
   void
   EventRouter::insertEvent (double t, GlobalIndex id)
   {
+    if (flat)
+      {
+	insertFlat (t, id);
+	return;
+      }
     Inserter i (t, id);
     routingTable.search (id, &i);
   }
@@ -49,11 +161,117 @@ namespace MUSIC {
   void
   EventRouter::insertEvent (double t, LocalIndex id)
   {
+    if (flat)
+      {
+	insertFlat (t, id);
+	return;
+      }
     Inserter i (t, id);
     routingTable.search (id, &i);
   }
 
 
+  static bool
+  lessEventId (const Event& e1, const Event& e2)
+  {
+    return e1.id < e2.id;
+  }
+
+
+  // Insert n events at once.  The events are collected per buffer
+  // and appended with a single FIBO::insert for each buffer.  With
+  // overlapping routing intervals, the batch is sorted on index so
+  // that the events routed through each interval form a contiguous
+  // range.
+  void
+  EventRouter::insertEvents (const double* t, const int* id, size_t n)
+  {
+    if (flat)
+      {
+	for (size_t i = 0; i < n; ++i)
+	  {
+	    int r = findInterval (id[i]);
+	    if (r >= 0)
+	      flatStaging[r]->push_back (Event (t[i],
+						id[i] - flatIntervals[r].offset ()));
+	  }
+	flushStaging ();
+	return;
+      }
+
+    batch.clear ();
+    for (size_t i = 0; i < n; ++i)
+      batch.push_back (Event (t[i], id[i]));
+    routeBatch ();
+  }
+
+
+  void
+  EventRouter::insertEvents (const Event* events, size_t n)
+  {
+    if (flat)
+      {
+	for (size_t i = 0; i < n; ++i)
+	  {
+	    int r = findInterval (events[i].id);
+	    if (r >= 0)
+	      flatStaging[r]->push_back (Event (events[i].t,
+						events[i].id
+						- flatIntervals[r].offset ()));
+	  }
+	flushStaging ();
+	return;
+      }
+
+    batch.assign (events, events + n);
+    routeBatch ();
+  }
+
+
+  void
+  EventRouter::routeBatch ()
+  {
+    bool sorted = true;
+    for (size_t i = 1; i < batch.size (); ++i)
+      if (batch[i].id < batch[i - 1].id)
+	{
+	  sorted = false;
+	  break;
+	}
+    if (!sorted)
+      std::stable_sort (batch.begin (), batch.end (), lessEventId);
+
+    for (std::vector<EventRoutingData>::iterator r = routingIntervals.begin ();
+	 r != routingIntervals.end ();
+	 ++r)
+      {
+	std::vector<Event>::iterator e
+	  = std::lower_bound (batch.begin (),
+			      batch.end (),
+			      Event (0.0, r->begin ()),
+			      lessEventId);
+	if (e == batch.end () || e->id >= r->end ())
+	  continue;
+	std::vector<Event>& dest = staging[r->buffer ()];
+	for (; e != batch.end () && e->id < r->end (); ++e)
+	  dest.push_back (Event (e->t, e->id - r->offset ()));
+      }
+    flushStaging ();
+  }
+
+
+  void
+  EventRouter::flushStaging ()
+  {
+    for (StagingMap::iterator s = staging.begin (); s != staging.end (); ++s)
+      if (!s->second.empty ())
+	{
+	  s->first->insert (&s->second[0], s->second.size ());
+	  s->second.clear ();
+	}
+  }
+
+
   void
   EventRoutingMap::insert (IndexInterval i, FIBO* buffer)
   {
@@ -48,6 +48,7 @@ set(MUSIC_SOURCES
   connection.cc
   connectivity.cc
   connector.cc
+  copy_plan.cc
   distributor.cc
   error.cc
   event_router.cc
@@ -55,6 +56,8 @@ set(MUSIC_SOURCES
   index_map_factory.cc
   ioutils.cc
   linear_index.cc
+  message_log.cc
+  neighbor_exchange.cc
   parse.cc
   permutation_index.cc
   port.cc
@@ -63,6 +66,7 @@ set(MUSIC_SOURCES
   sampler.cc
   setup.cc
   spatial.cc
+  statistics.cc
   subconnector.cc
   synchronizer.cc
   temporal.cc
@@ -87,6 +91,7 @@ set(MUSIC_HEADERS
   music/connection.hh
   music/connectivity.hh
   music/connector.hh
+  music/copy_plan.hh
   music/data_map.hh
   music/debug.hh
   music/distributor.hh
@@ -99,6 +104,8 @@ set(MUSIC_HEADERS
   music/ioutils.hh
   music/linear_index.hh
   music/message.hh
+  music/message_log.hh
+  music/neighbor_exchange.hh
   music/parse.hh
   music/permutation_index.hh
   music/port.hh
@@ -107,6 +114,7 @@ set(MUSIC_HEADERS
   music/sampler.hh
   music/setup.hh
   music/spatial.hh
+  music/statistics.hh
   music/subconnector.hh
   music/synchronizer.hh
   music/temporal.hh
@@ -129,6 +137,7 @@ set(MUSIC_PUBLIC_HEADERS
   ${CMAKE_SOURCE_DIR}/src/music/connectivity.hh
   ${CMAKE_SOURCE_DIR}/src/music/connector.hh
   ${CMAKE_SOURCE_DIR}/src/music/connection.hh
+  ${CMAKE_SOURCE_DIR}/src/music/copy_plan.hh
   ${CMAKE_SOURCE_DIR}/src/music/cont_data.hh
   ${CMAKE_SOURCE_DIR}/src/music/distributor.hh
   ${CMAKE_SOURCE_DIR}/src/music/event.hh
@@ -143,6 +152,8 @@ set(MUSIC_PUBLIC_HEADERS
   ${CMAKE_SOURCE_DIR}/src/music/interval_tree.hh
   ${CMAKE_SOURCE_DIR}/src/music/ioutils.hh
   ${CMAKE_SOURCE_DIR}/src/music/message.hh
+  ${CMAKE_SOURCE_DIR}/src/music/message_log.hh
+  ${CMAKE_SOURCE_DIR}/src/music/neighbor_exchange.hh
   ${PROJECT_BINARY_DIR}/music/music-config.hh
   ${CMAKE_SOURCE_DIR}/src/music/port.hh
   ${CMAKE_SOURCE_DIR}/src/music/permutation_index.hh
@@ -150,6 +161,7 @@ set(MUSIC_PUBLIC_HEADERS
   ${CMAKE_SOURCE_DIR}/src/music/setup.hh
   ${CMAKE_SOURCE_DIR}/src/music/sampler.hh
   ${CMAKE_SOURCE_DIR}/src/music/spatial.hh
+  ${CMAKE_SOURCE_DIR}/src/music/statistics.hh
   ${CMAKE_SOURCE_DIR}/src/music/subconnector.hh
   ${CMAKE_SOURCE_DIR}/src/music/synchronizer.hh
   ${CMAKE_SOURCE_DIR}/src/music/temporal.hh
@@ -16,8 +16,12 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+//#define MUSIC_DEBUG 1
+
 #include <limits>
+#include <algorithm>
 
+#include "music/debug.hh"
 #include "music/index_map.hh"
 
 namespace MUSIC {
@@ -30,6 +34,57 @@ namespace MUSIC {
 	    || (a.begin () == b.begin () && a.end () < b.end ()));
   }
   
+
+  void
+  coalesceIntervals (std::vector<IndexInterval>& intervals)
+  {
+    sort (intervals.begin (), intervals.end ());
+    if (intervals.empty ())
+      return;
+    int nIndices = intervals[0].end () - intervals[0].begin ();
+    std::vector<IndexInterval>::iterator last = intervals.begin ();
+    for (std::vector<IndexInterval>::iterator i = intervals.begin () + 1;
+	 i != intervals.end ();
+	 ++i)
+      {
+	nIndices += i->end () - i->begin ();
+	if (i->begin () == last->end () && i->local () == last->local ())
+	  last->setEnd (i->end ());
+	else
+	  *++last = *i;
+      }
+    intervals.erase (last + 1, intervals.end ());
+    MUSIC_LOGR ("coalesced " << nIndices << " indices into "
+		<< intervals.size () << " intervals (compression ratio "
+		<< double (nIndices) / intervals.size () << ")");
+  }
+
+  
+  void
+  IndexMap::collectIntervals ()
+  {
+    if (intervals_.empty ())
+      for (iterator i = begin (); i != end (); ++i)
+	intervals_.push_back (*i);
+  }
+
+
+  const IndexInterval*
+  IndexMap::data ()
+  {
+    collectIntervals ();
+    return intervals_.empty () ? 0 : &intervals_[0];
+  }
+
+
+  size_t
+  IndexMap::size ()
+  {
+    collectIntervals ();
+    return intervals_.size ();
+  }
+
+  
   const IndexInterval
   IndexMap::iterator::operator* ()
   {
@@ -43,7 +43,7 @@ namespace MUSIC {
   void
   IndexMapFactory::build ()
   {
-    sort (indices_.begin (), indices_.end ());
+    coalesceIntervals (indices_);
   }
   
 
@@ -0,0 +1,106 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "music/debug.hh"
+
+#include <algorithm>
+
+#include "music/message.hh"
+#include "music/message_log.hh"
+
+namespace MUSIC {
+
+  MessageLog::MessageLog ()
+    : log_ (1), references_ (1)
+  {
+  }
+
+
+  void
+  MessageLog::removeReference ()
+  {
+    if (--references_ == 0)
+      delete this;
+  }
+
+
+  int
+  MessageLog::addReader ()
+  {
+    void* data;
+    int size;
+    log_.nextBlockNoClear (data, size);
+    cursors_.push_back (size);
+    return cursors_.size () - 1;
+  }
+
+
+  void
+  MessageLog::insert (double t, void* msg, size_t size)
+  {
+    if (cursors_.empty ())
+      return;
+    MessageHeader header (t, size);
+    log_.insert (header.data (), sizeof (MessageHeader));
+    log_.insert (msg, size);
+  }
+
+
+  bool
+  MessageLog::isRead (int reader)
+  {
+    void* data;
+    int size;
+    log_.nextBlockNoClear (data, size);
+    return cursors_[reader] == size;
+  }
+
+  
+  void
+  MessageLog::unread (int reader, void*& data, int& size)
+  {
+    log_.nextBlockNoClear (data, size);
+    data = static_cast<char*> (data) + cursors_[reader];
+    size -= cursors_[reader];
+  }
+
+
+  // Data is discarded when all readers have passed it.  To avoid
+  // moving data on every call, a part which is still needed by some
+  // reader is only moved once it is no more than half of the log.
+  void
+  MessageLog::markRead (int reader)
+  {
+    void* data;
+    int size;
+    log_.nextBlockNoClear (data, size);
+    cursors_[reader] = size;
+    int oldest = *std::min_element (cursors_.begin (), cursors_.end ());
+    if (oldest == size)
+      log_.clear ();
+    else if (2 * oldest >= size)
+      log_.discard (oldest);
+    else
+      return;
+    for (std::vector<int>::iterator c = cursors_.begin ();
+	 c != cursors_.end ();
+	 ++c)
+      *c -= oldest;
+  }
+
+}
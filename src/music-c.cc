@@ -339,6 +339,17 @@ MUSIC_EventInputPort_mapLocalIndex (MUSIC_EventInputPort *Port,
 }
 
 
+void
+MUSIC_EventOutputPort_insertEvents (MUSIC_EventOutputPort *Port,
+				    double *t,
+				    int *ids,
+				    size_t n)
+{
+  MUSIC::EventOutputPort* cxxPort = (MUSIC::EventOutputPort *) Port;
+  cxxPort->insertEvents (t, ids, n);
+}
+
+
 void
 MUSIC_MessageOutputPort_map_no_handler (MUSIC_MessageOutputPort *Port)
 {
@@ -497,6 +508,22 @@ MUSIC_tick (MUSIC_Runtime *runtime)
 }
 
 
+void
+MUSIC_advance (MUSIC_Runtime *runtime, int nTicks)
+{
+  MUSIC::Runtime* cxxRuntime = (MUSIC::Runtime *) runtime;
+  cxxRuntime->advance (nTicks);
+}
+
+
+void
+MUSIC_tickUntil (MUSIC_Runtime *runtime, double t)
+{
+  MUSIC::Runtime* cxxRuntime = (MUSIC::Runtime *) runtime;
+  cxxRuntime->tickUntil (t);
+}
+
+
 double
 MUSIC_time (MUSIC_Runtime *runtime)
 {
@@ -505,6 +532,14 @@ MUSIC_time (MUSIC_Runtime *runtime)
 }
 
 
+double
+MUSIC_nextCommunicationTime (MUSIC_Runtime *runtime)
+{
+  MUSIC::Runtime* cxxRuntime = (MUSIC::Runtime *) runtime;
+  return cxxRuntime->nextCommunicationTime ();
+}
+
+
 /* Finalization */
 
 void
@@ -40,11 +40,13 @@ namespace MUSIC {
     int current;
     int top;			// upper bound of valid data
 
+    int capacity (int nBuffered);
     void grow (int newSize);
     
     int maxBlockSize_;
+    int highWater_;
   public:
-    BIFO () { }
+    BIFO () : highWater_ (0) { }
     void configure (int elementSize, int maxBlockSize);
 
     // Duplicate the single element in the buffer to a total of nElements
@@ -57,6 +59,8 @@ namespace MUSIC {
     // size in bytes
     void trimBlock (int size);
     void* next ();
+    // Largest amount of buffered data so far, in bytes
+    int highWater () const { return highWater_; }
   };
   
   
@@ -18,32 +18,59 @@
 
 #ifndef MUSIC_FIBO_HH
 
-#include <vector>
-
 namespace MUSIC {
 
+  // Storage is uninitialized memory which grows geometrically and is
+  // retained at its high-water mark, so that a FIBO in steady state
+  // neither allocates nor clears memory.
+
   class FIBO {
   private:
     static const int nInitial = 10;
+    static const int minInitialSize = 4096;
+    static bool hugePages_;
     
-    std::vector<char> buffer;
+    char* buffer;
+    char* spare;
+    int spareSize;
     int elementSize;
     int size;
     int current;
+    int highWater_;
 
+    static char* allocate (int& nBytes);
     void grow (int newSize);
+
+    // Not copyable
+    FIBO (const FIBO&);
+    FIBO& operator= (const FIBO&);
     
   public:
-    FIBO () { }
+    FIBO ();
     FIBO (int elementSize);
-    void configure (int elementSize);
+    ~FIBO ();
+    // capacityHint is the expected maximal number of elements
+    void configure (int elementSize, int capacityHint = 0);
     bool isEmpty ();
     // NOTE: find better return type
     void* insert ();
     void insert (void* elements, int n_elements);
+    // Reserve room for a block of at most maxBlockSize bytes which
+    // is then committed with trimBlock
+    void* insertBlock (int maxBlockSize);
+    void trimBlock (int blockSize);
     void clear ();
+    // Remove the first nBytes bytes
+    void discard (int nBytes);
     void nextBlockNoClear (void*& data, int& size);
     void nextBlock (void*& data, int& size);
+    // Like nextBlock, but the returned block stays intact until the
+    // next call while insertion continues in a second buffer
+    void swapBlock (void*& data, int& size);
+    // Largest block taken out so far, in bytes
+    int highWater () const { return highWater_; }
+    // Align large buffers to huge pages
+    static void useHugePages (bool flag) { hugePages_ = flag; }
   };
   
   
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <music/BIFO.hh>
+#include <music/copy_plan.hh>
 #include <music/interval_tree.hh>
 
 namespace MUSIC {
@@ -54,10 +55,13 @@ namespace MUSIC {
     
     typedef std::vector<Interval> Intervals;
     typedef std::map<BIFO*, Intervals> BufferMap;
+    typedef std::vector<std::pair<BIFO*, CopyPlan> > Plans;
 
     DataMap* dataMap;
     int allowedBuffered_;
     BufferMap buffers;
+    // compiled from buffers by initialize ()
+    Plans plans;
 
     IntervalTree<int, IndexInterval>* buildTree ();
   public:
@@ -32,9 +32,24 @@ namespace MUSIC {
     CONT_MSG,
     SPIKE_MSG,
     MESSAGE_MSG,
-    FLUSH_MSG
+    FLUSH_MSG,
+    PROTOCOL_MSG
   };
 
+  // Optional protocol features.  A feature is used on a connection
+  // only if both sides enable it (see Connector::negotiateProtocol).
+
+  // Send each block as a single message sized by the receiver
+  // through MPI::Probe
+  const int PROTOCOL_PROBE = 1;
+
+  // Send events in the compact wire format (see EventSubconnector)
+  const int PROTOCOL_COMPACT = 2;
+
+  // Transfer all data of the connector through a neighborhood
+  // collective (see NeighborExchange)
+  const int PROTOCOL_NEIGHBORHOOD = 4;
+
 }
 
 #define MUSIC_COMMUNICATION_HH
@@ -46,6 +46,7 @@ namespace MUSIC {
     bool postponeSetup () { return postponeSetup_; }
     void writeEnv ();
     int color () { return color_; };
+    std::string applicationName () { return applicationName_; }
     bool lookup (std::string name);
     bool lookup (std::string name, std::string* result);
     bool lookup (std::string name, int* result);
@@ -49,9 +49,10 @@ namespace MUSIC {
     SpatialNegotiator* spatialNegotiator_;
     MPI::Intracomm comm;
     MPI::Intercomm intercomm;
+    int protocol_;
     
   public:
-    Connector () { }
+    Connector () : protocol_ (0) { }
     Connector (ConnectorInfo info_,
 	       SpatialNegotiator* spatialNegotiator_,
 	       MPI::Intracomm c);
@@ -72,12 +73,19 @@ namespace MUSIC {
     virtual Synchronizer* synchronizer () = 0;
     void createIntercomm ();
     void freeIntercomm ();
+    void negotiateProtocol (int protocol);
+    int protocol () const { return protocol_; }
+    MPI::Intracomm communicator () { return comm; }
+    MPI::Intercomm intercommunicator () { return intercomm; }
     virtual void
     spatialNegotiation (std::vector<OutputSubconnector*>& /* osubconn */,
 			std::vector<InputSubconnector*>& /* isubconn */) { }
     virtual void initialize () = 0;
     virtual void prepareForSimulation () { }
     virtual void tick (bool& requestCommunication) = 0;
+    // True if tick () only needs to be called at the times given by
+    // Synchronizer::nextCommunicationTime ()
+    virtual bool idleBetweenCommunications () { return false; }
   };
 
   class PostCommunicationConnector : virtual public Connector {
@@ -106,6 +114,8 @@ namespace MUSIC {
   protected:
     Sampler& sampler_;
     MPI::Datatype type_;
+    bool zeroCopy_;
+    double copyTime_;
     // We need to allocate instances of ContOutputConnector and
     // ContInputConnector and, therefore need dummy versions of the
     // following virtual functions:
@@ -114,8 +124,13 @@ namespace MUSIC {
     virtual void tick (bool&) { }
   public:
     ContConnector (Sampler& sampler, MPI::Datatype type)
-      : sampler_ (sampler), type_ (type) { }
+      : sampler_ (sampler), type_ (type), zeroCopy_ (false), copyTime_ (0.0) { }
     ClockState remoteTickInterval (ClockState tickInterval);
+    // transfer data directly from and to application memory
+    void setZeroCopy () { zeroCopy_ = true; }
+    // time spent in the Distributor, Collector and Sampler during
+    // the simulation (see Runtime::statistics ())
+    double copyTime () const { return copyTime_; }
   };  
   
   class InterpolatingConnector : virtual public Connector {
@@ -124,6 +139,7 @@ namespace MUSIC {
   class ContOutputConnector : public ContConnector, public OutputConnector {
   protected:
     Distributor distributor_;
+    std::vector<ContOutputSubconnector*> subconnectors_;
   public:
     ContOutputConnector (ConnectorInfo connInfo,
 			 SpatialNegotiator* spatialNegotiator,
@@ -133,15 +149,19 @@ namespace MUSIC {
     OutputSubconnector* makeOutputSubconnector (int remoteRank);
     void addRoutingInterval (IndexInterval i, OutputSubconnector* osubconn);
     Connector* specialize (Clock& localTime);
+    // Must be called before MPI::Finalize
+    void freeDatatypes () { distributor_.freeDatatypes (); }
   };
   
-  class PlainContOutputConnector : public ContOutputConnector {
+  class PlainContOutputConnector : public ContOutputConnector,
+				   public PostCommunicationConnector {
     OutputSynchronizer synch;
   public:
     PlainContOutputConnector (ContOutputConnector& connector);
     Synchronizer* synchronizer () { return &synch; }
     void initialize ();
     void tick (bool& requestCommunication);
+    void postCommunication ();
   };
   
   class InterpolatingContOutputConnector : public ContOutputConnector,
@@ -199,6 +219,8 @@ namespace MUSIC {
   };
 
   class EventConnector : virtual public Connector {
+  public:
+    bool idleBetweenCommunications () { return true; }
   };
   
   class EventOutputConnector : public OutputConnector, public EventConnector {
@@ -224,12 +246,14 @@ namespace MUSIC {
     InputSynchronizer synch;
     EventHandlerPtr handleEvent_;
     Index::Type type_;
+    FIBO* events_;
   public:
     EventInputConnector (ConnectorInfo connInfo,
 			 SpatialInputNegotiator* spatialNegotiator,
 			 EventHandlerPtr handleEvent,
 			 Index::Type type,
-			 MPI::Intracomm comm);
+			 MPI::Intracomm comm,
+			 FIBO* events = NULL);
     InputSubconnector* makeInputSubconnector (int remoteRank, int receiverRank);
     Synchronizer* synchronizer () { return &synch; }
     void initialize ();
@@ -237,28 +261,25 @@ namespace MUSIC {
   };
   
   class MessageConnector : virtual public Connector {
+  public:
+    bool idleBetweenCommunications () { return true; }
   };
   
   class MessageOutputConnector : public OutputConnector,
-				 public MessageConnector,
-				 public PostCommunicationConnector {
+				 public MessageConnector {
   private:
     OutputSynchronizer synch;
-    FIBO buffer;
-    bool bufferAdded;
-    std::vector<FIBO*>& buffers_;
+    MessageLog* log_;
     void send ();
   public:
     MessageOutputConnector (ConnectorInfo connInfo,
 			    SpatialOutputNegotiator* spatialNegotiator,
 			    MPI::Intracomm comm,
-			    std::vector<FIBO*>& buffers);
+			    MessageLog* log);
     OutputSubconnector* makeOutputSubconnector (int remoteRank);
-    void addRoutingInterval (IndexInterval i, OutputSubconnector* osubconn);
     Synchronizer* synchronizer () { return &synch; }
     void initialize ();
     void tick (bool& requestCommunication);
-    void postCommunication ();
   };
   
   class MessageInputConnector : public InputConnector, public MessageConnector {
@@ -0,0 +1,64 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUSIC_COPY_PLAN_HH
+
+#include <vector>
+
+#include <music/data_map.hh>
+
+namespace MUSIC {
+
+  // A CopyPlan moves continuous data between the application array,
+  // where it is scattered over a number of runs, and a packed
+  // communication buffer.  The plan is compiled once when
+  // connections are initialized: runs which are adjacent in the
+  // application array are merged and sequences of runs of equal
+  // length at a constant stride, as produced by round robin index
+  // maps, are grouped into one segment which is copied by a loop
+  // specialized for the run length.
+
+  class CopyPlan {
+    struct Segment {
+      int begin;   // offset of first run in the application array
+      int length;  // length of each run
+      int stride;  // distance between runs in the application array
+      int count;   // number of runs
+    };
+    std::vector<Segment> segments_;
+    int size_;
+  public:
+    CopyPlan () : size_ (0) { }
+    // Runs are added in the order they appear in the packed buffer.
+    // All quantities are in bytes.
+    void addRun (int begin, int length);
+    // Size of the packed buffer
+    int size () const { return size_; }
+    int nSegments () const { return segments_.size (); }
+    // application array -> packed buffer
+    void gather (ContDataT* dest, const ContDataT* src) const;
+    // packed buffer -> application array
+    void scatter (ContDataT* dest, const ContDataT* src) const;
+    // Committed datatype selecting the runs of an array of type
+    MPI::Datatype datatype (MPI::Datatype type) const;
+  };
+
+}
+
+#define MUSIC_COPY_PLAN_HH
+#endif
@@ -26,11 +26,29 @@
 #include <vector>
 
 #include <music/FIBO.hh>
+#include <music/copy_plan.hh>
 #include <music/interval_tree.hh>
 
 namespace MUSIC {
 
   class Distributor {
+  public:
+    // Data routed to one buffer.  With direct sends, the latest sample
+    // is not copied to the buffer right away.  It is left pending in
+    // the application array until it is either sent straight from
+    // there, using the derived datatype, or stored after
+    // communication.
+    class Plan {
+    public:
+      FIBO* buffer;
+      CopyPlan copy;
+      MPI::Datatype type;	// selects the plan's data in base
+      ContDataT* base;
+      bool pending;
+      Plan (FIBO* b) : buffer (b), base (NULL), pending (false) { }
+      void store ();
+    };
+  private:
     class Interval : public MUSIC::Interval {
     public:
       Interval (IndexInterval& interval);
@@ -54,17 +72,31 @@ namespace MUSIC {
     
     typedef std::vector<Interval> Intervals;
     typedef std::map<FIBO*, Intervals> BufferMap;
+    typedef std::vector<Plan> Plans;
 
     DataMap* dataMap;
+    int allowedBuffered_;
+    bool direct_;
     BufferMap buffers;
+    // compiled from buffers by initialize ()
+    Plans plans;
 
     IntervalTree<int, IndexInterval>* buildTree ();
   public:
+    Distributor () : direct_ (false) { }
     // caller manages deallocation but guarantees existence
-    void configure (DataMap* dmap);
+    void configure (DataMap* dmap, int allowedBuffered);
+    // must be called before initialize ()
+    void setDirect () { direct_ = true; }
     void initialize ();
     void addRoutingInterval (IndexInterval i, FIBO* b);
     void distribute ();
+    // store samples which were not sent directly
+    void storePending ();
+    Plan* plan (FIBO* buffer);
+    // free the datatypes of direct sends; must be called before
+    // MPI::Finalize
+    void freeDatatypes ();
   };
     
 }
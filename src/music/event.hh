@@ -18,6 +18,8 @@
 
 #ifndef MUSIC_EVENT_HH
 
+#include <cstddef>
+
 #include <music/index_map.hh>
 
 namespace MUSIC {
@@ -30,15 +32,25 @@ namespace MUSIC {
     bool operator< (const Event& other) const { return t < other.t; }
   };
 
+  // Event handlers receive events one block at a time through
+  // handleEvents.  The default implementation calls the single event
+  // operator for each event.
+  
   class EventHandlerGlobalIndex {
   public:
     virtual ~EventHandlerGlobalIndex() { }
     virtual void operator () (double t, GlobalIndex id) = 0;
+    virtual void handleEvents (const Event* events, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+	(*this) (events[i].t, GlobalIndex (events[i].id));
+    }
   };
   
   class EventHandlerGlobalIndexDummy : public EventHandlerGlobalIndex {
   public:
     virtual void operator () (double, GlobalIndex) { };
+    virtual void handleEvents (const Event*, size_t) { };
   };
   
   class EventHandlerGlobalIndexProxy
@@ -52,17 +64,45 @@ namespace MUSIC {
     {
       eventHandler (t, id);
     }
+    void handleEvents (const Event* events, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+	eventHandler (events[i].t, events[i].id);
+    }
+  };
+
+  // Adapts a statically typed functor, called as f (t, id), to the
+  // handler interface.  The block handler calls the functor directly
+  // so that the calls can be inlined.
+  template<class F>
+  class EventHandlerGlobalIndexAdaptor : public EventHandlerGlobalIndex {
+    F f_;
+  public:
+    EventHandlerGlobalIndexAdaptor (const F& f) : f_ (f) { }
+    F& functor () { return f_; }
+    void operator () (double t, GlobalIndex id) { f_ (t, id); }
+    void handleEvents (const Event* events, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+	f_ (events[i].t, GlobalIndex (events[i].id));
+    }
   };
   
   class EventHandlerLocalIndex {
   public:
     virtual ~EventHandlerLocalIndex() { }
     virtual void operator () (double t, LocalIndex id) = 0;
+    virtual void handleEvents (const Event* events, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+	(*this) (events[i].t, LocalIndex (events[i].id));
+    }
   };
 
   class EventHandlerLocalIndexDummy : public EventHandlerLocalIndex {
   public:
     virtual void operator () (double, LocalIndex) { };
+    virtual void handleEvents (const Event*, size_t) { };
   };
 
   class EventHandlerLocalIndexProxy
@@ -76,6 +116,25 @@ namespace MUSIC {
     {
       eventHandler (t, id);
     }
+    void handleEvents (const Event* events, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+	eventHandler (events[i].t, events[i].id);
+    }
+  };
+
+  template<class F>
+  class EventHandlerLocalIndexAdaptor : public EventHandlerLocalIndex {
+    F f_;
+  public:
+    EventHandlerLocalIndexAdaptor (const F& f) : f_ (f) { }
+    F& functor () { return f_; }
+    void operator () (double t, LocalIndex id) { f_ (t, id); }
+    void handleEvents (const Event* events, size_t n)
+    {
+      for (size_t i = 0; i < n; ++i)
+	f_ (events[i].t, LocalIndex (events[i].id));
+    }
   };
 
   class EventHandlerPtr {
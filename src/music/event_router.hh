@@ -18,6 +18,7 @@
 
 #ifndef MUSIC_EVENT_ROUTER_HH
 
+#include <cstddef>
 #include <map>
 #include <vector>
 
@@ -38,6 +39,7 @@ namespace MUSIC {
     int begin () const { return interval_.begin (); }
     int end () const { return interval_.end (); }
     int offset () const { return interval_.local (); }
+    FIBO* buffer () const { return buffer_; }
     void insert (double t, int id) {
       Event* e = static_cast<Event*> (buffer_->insert ());
       e->t = t;
@@ -59,12 +61,39 @@ namespace MUSIC {
       }
     };
     
+    std::vector<EventRoutingData> routingIntervals;
+
+    // The interval tree is used when routing intervals overlap
     IntervalTree<int, EventRoutingData> routingTable;
+
+    // Otherwise, routing intervals are sorted in a flat array.  If
+    // the index range is dense we also use a direct lookup table
+    // from index to routing interval.
+    bool flat;
+    std::vector<int> flatBegins;
+    std::vector<EventRoutingData> flatIntervals;
+    int tableBase;
+    std::vector<int> table;
+
+    // Used by insertEvents
+    std::vector<Event> batch;
+    typedef std::map<FIBO*, std::vector<Event> > StagingMap;
+    StagingMap staging;
+    std::vector<std::vector<Event>*> flatStaging;
+
+    bool buildFlatTable ();
+    int findInterval (int id) const;
+    void insertFlat (double t, int id);
+    void routeBatch ();
+    void flushStaging ();
   public:
+    EventRouter () : flat (false) { }
     void insertRoutingInterval (IndexInterval i, FIBO* b);
     void buildTable ();
     void insertEvent (double t, GlobalIndex id);
     void insertEvent (double t, LocalIndex id);
+    void insertEvents (const double* t, const int* id, size_t n);
+    void insertEvents (const Event* events, size_t n);
   };
     
 
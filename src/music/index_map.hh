@@ -19,6 +19,8 @@
 #ifndef MUSIC_INDEX_MAP_HH
 
 #include <memory>
+#include <vector>
+#include <cstddef>
 
 #include <music/interval.hh>
 
@@ -58,6 +60,10 @@ namespace MUSIC {
 
   bool operator< (const IndexInterval& a, const IndexInterval& b);
 
+  // Sort intervals and join adjacent intervals with the same local
+  // offset
+  void coalesceIntervals (std::vector<IndexInterval>& intervals);
+
   class IndexMap {
   public:
     class IteratorImplementation {
@@ -105,7 +111,16 @@ namespace MUSIC {
     virtual iterator begin () = 0;
     virtual const iterator end () const = 0;
 
+    // Contiguous view of the index intervals.  The default
+    // implementation collects the intervals through the iterator
+    // interface on first use.
+    virtual const IndexInterval* data ();
+    virtual size_t size ();
+
     virtual IndexMap* copy () = 0;
+  private:
+    std::vector<IndexInterval> intervals_;
+    void collectIntervals ();
   };
 
 }
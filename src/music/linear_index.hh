@@ -47,6 +47,8 @@ namespace MUSIC {
     LinearIndex (GlobalIndex baseindex, int size);
     virtual IndexMap::iterator begin ();
     virtual const IndexMap::iterator end () const;
+    virtual const IndexInterval* data () { return &interval_; }
+    virtual size_t size () { return 1; }
     virtual IndexMap* copy ();
   };
 
@@ -0,0 +1,56 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUSIC_MESSAGE_LOG_HH
+
+#include <cstddef>
+#include <vector>
+
+#include <music/FIBO.hh>
+
+namespace MUSIC {
+
+  // Messages inserted into a MessageOutputPort are stored once in a
+  // log which is shared by all subconnectors of the port.  Each
+  // subconnector is a reader with its own cursor into the log.  Data
+  // which all readers have passed is discarded.
+  //
+  // The log is reference counted since the port and the
+  // subconnectors are deleted independently.
+
+  class MessageLog {
+    FIBO log_;
+    std::vector<int> cursors_;
+    int references_;
+    ~MessageLog () { }
+  public:
+    MessageLog ();
+    void addReference () { ++references_; }
+    void removeReference ();
+    int addReader ();
+    void insert (double t, void* msg, size_t size);
+    bool isRead (int reader);
+    // Data inserted since the reader last called markRead
+    void unread (int reader, void*& data, int& size);
+    void markRead (int reader);
+  };
+
+}
+
+#define MUSIC_MESSAGE_LOG_HH
+#endif
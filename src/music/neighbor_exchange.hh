@@ -0,0 +1,86 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUSIC_NEIGHBOR_EXCHANGE_HH
+
+#include <mpi.h>
+
+#include <vector>
+
+#include <music/connector.hh>
+#include <music/subconnector.hh>
+
+namespace MUSIC {
+
+  // The NeighborExchange transfers the data of all subconnectors of
+  // one connector through MPI neighborhood collectives instead of
+  // the pair-wise transfers of the Runtime schedule.  It is built on
+  // a distributed graph communicator spanning the processes of both
+  // applications of the connector, with one edge per subconnector.
+  // All these processes communicate at the same ticks on this
+  // connector, so each communication is a collective operation.
+  //
+  // In addition, each receiver has a control edge from one sender,
+  // through which the end of the data flow is signalled when
+  // flushing.  Since a receiver may still be ticking while the
+  // sender flushes, flush rounds look the same as other rounds.
+  //
+  // The exchange takes over the subconnectors given to it.
+
+  class NeighborExchange {
+    static const int FLUSH_MARK = -1;
+    Synchronizer* synch_;
+    MPI::Intracomm comm_;	// the local application
+    MPI_Comm graph_;
+    bool sender_;
+    bool initialTransfer_;
+    bool flushed_;
+    std::vector<OutputSubconnector*> outputs_;
+    std::vector<InputSubconnector*> inputs_;
+    // arguments to MPI_Neighbor_alltoallw; control edges come last
+    std::vector<int> sendCounts_;
+    std::vector<MPI_Aint> sendDispls_;
+    std::vector<MPI_Datatype> sendTypes_;
+    std::vector<int> receiveCounts_;
+    std::vector<MPI_Aint> receiveDispls_;
+    std::vector<MPI_Datatype> receiveTypes_;
+    // where to receive the block of each input subconnector
+    std::vector<void*> blocks_;
+    std::vector<char> buffer_;
+    double communicationTime_;
+    bool collectBlocks ();
+    bool transfer (int control, bool deliver);
+  public:
+    NeighborExchange (Connector* connector,
+		      std::vector<OutputSubconnector*>& outputs,
+		      std::vector<InputSubconnector*>& inputs);
+    ~NeighborExchange ();
+    // True if the MPI library supports neighborhood collectives
+    static bool isAvailable ();
+    void initialCommunication ();
+    void maybeCommunicate ();
+    void flush (bool& dataStillFlowing);
+    void freeCommunicator ();
+    // Time spent in maybeCommunicate (see Runtime::statistics ())
+    double communicationTime () const { return communicationTime_; }
+  };
+
+}
+
+#define MUSIC_NEIGHBOR_EXCHANGE_HH
+#endif
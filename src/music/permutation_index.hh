@@ -53,6 +53,11 @@ namespace MUSIC {
     PermutationIndex (std::vector<IndexInterval>& indices);
     virtual IndexMap::iterator begin ();
     virtual const IndexMap::iterator end () const;
+    virtual const IndexInterval* data ()
+    {
+      return indices_.empty () ? 0 : &indices_[0];
+    }
+    virtual size_t size () { return indices_.size (); }
     virtual IndexMap* copy ();    
   };
 
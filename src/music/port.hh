@@ -26,6 +26,7 @@
 #include <music/index_map.hh>
 #include <music/event.hh>
 #include <music/message.hh>
+#include <music/message_log.hh>
 #include <music/connector.hh>
 #include <music/sampler.hh>
 #include <music/event_router.hh>
@@ -152,9 +153,17 @@ namespace MUSIC {
 
   
   class EventOutputPort : public EventPort,
-			  public OutputRedistributionPort {
+			  public OutputRedistributionPort,
+			  public TickingPort {
     EventRoutingMap* routingMap;
     EventRouter router;
+    // Events inserted by each thread since the last tick.  Shards
+    // are padded so that threads do not write to the same cache line.
+    struct Shard {
+      std::vector<Event> events;
+      char padding[64];
+    };
+    std::vector<Shard> shards;
   public:
     EventOutputPort (Setup* s, std::string id);
     void map (IndexMap* indices, Index::Type type);
@@ -163,6 +172,14 @@ namespace MUSIC {
     void buildTable ();
     void insertEvent (double t, GlobalIndex id);
     void insertEvent (double t, LocalIndex id);
+    void insertEvents (const double* t, const int* id, size_t n);
+    // Concurrent insertion: thread must be in [0, nThreads) and each
+    // thread must use its own number
+    void setThreads (int nThreads);
+    void insertEvent (double t, GlobalIndex id, int thread);
+    void insertEvent (double t, LocalIndex id, int thread);
+    void mergeThreadEvents ();
+    void tick ();
   };
 
 
@@ -171,6 +188,8 @@ namespace MUSIC {
   private:
     Index::Type type_;
     EventHandlerPtr handleEvent_;
+    bool buffered_;
+    FIBO events_;
   public:
     EventInputPort (Setup* s, std::string id);
     void map (IndexMap* indices,
@@ -187,6 +206,21 @@ namespace MUSIC {
 	      EventHandlerLocalIndex* handleEvent,
 	      double accLatency,
 	      int maxBuffered);
+    // Without a handler, events are received into a buffer owned by
+    // the port and can be read after each call of Runtime::tick,
+    // advance or tickUntil.  The buffer holds the events of all ticks
+    // performed by that call.
+    void map (IndexMap* indices,
+	      Index::Type type,
+	      double accLatency = 0.0);
+    void map (IndexMap* indices,
+	      Index::Type type,
+	      double accLatency,
+	      int maxBuffered);
+    const Event* events ();
+    size_t nEvents ();
+    // Called by Runtime when entering tick, advance or tickUntil
+    void clearEvents ();
   protected:
     void mapImpl (IndexMap* indices,
 		  Index::Type type,
@@ -215,9 +249,10 @@ namespace MUSIC {
 
   class MessageOutputPort : public MessagePort,
 			    public OutputRedistributionPort {
-    std::vector<FIBO*> buffers;
+    MessageLog* log_;
   public:
     MessageOutputPort (Setup* s, std::string id);
+    ~MessageOutputPort ();
     void map ();
     void map (int maxBuffered);
     void insertMessage (double t, void* msg, size_t size);
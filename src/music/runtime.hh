@@ -25,6 +25,8 @@
 #include "music/port.hh"
 #include "music/clock.hh"
 #include "music/connector.hh"
+#include "music/neighbor_exchange.hh"
+#include "music/statistics.hh"
 
 namespace MUSIC {
 
@@ -45,32 +47,72 @@ namespace MUSIC {
 
     void tick ();
 
+    void advance (int nTicks);
+
+    void tickUntil (double t);
+
     double time ();
+
+    double nextCommunicationTime ();
+
+    // Counters of this process, summed per connector.  Must be
+    // called before finalize ().
+    Statistics statistics ();
     
   private:
     Clock localTime;
     MPI::Intracomm comm;
     std::vector<TickingPort*> tickingPorts;
+    // event input ports which may buffer events for the application
+    std::vector<EventInputPort*> eventInputPorts;
     std::vector<Connector*> connectors;
+    // connectors which need to be ticked at every tick
+    std::vector<Connector*> activeConnectors;
+    // the other connectors, which need ticking from nextIdleTick
+    std::vector<Connector*> idleConnectors;
+    ClockState nextIdleTick;
     std::vector<Subconnector*> schedule;
+    // connectors transferring data through neighborhood collectives
+    std::vector<NeighborExchange*> exchanges;
+    // the parts of schedule and exchanges which belong to
+    // activeConnectors
+    std::vector<Subconnector*> activeSchedule;
+    std::vector<NeighborExchange*> activeExchanges;
     std::vector<PostCommunicationConnector*> postCommunication;
+    // the subconnectors and exchange, if any, of each connector
+    std::vector<std::vector<Subconnector*> > connectorSubconnectors;
+    std::vector<NeighborExchange*> connectorExchanges;
+    std::string applicationName;
+    long long ticks;
+    double tickTime;
+    bool reportStatistics;
     static bool isInstantiated_;
 
     typedef std::vector<Connection*> Connections;
     typedef std::vector<OutputSubconnector*> OutputSubconnectors;
     typedef std::vector<InputSubconnector*> InputSubconnectors;
     
+    void selectMemoryPolicy (Setup* s);
     void takeTickingPorts (Setup* s);
     void connectToPeers (Connections* connections);
     void specializeConnectors (Connections* connections);
+    void negotiateProtocols (Setup* s);
     void spatialNegotiation (OutputSubconnectors&, InputSubconnectors&);
     void buildSchedule (int localRank,
 			OutputSubconnectors&,
 			InputSubconnectors&);
     void takePostCommunicators ();
+    void selectCommunicationMode (Setup* s);
+    void selectZeroCopy (Setup* s);
+    void selectPersistentRequests (Setup* s);
+    void selectStatistics (Setup* s);
     void buildTables (Setup* s);
     void temporalNegotiation (Setup* s, Connections* connections);
     void initialize ();
+    void clearEvents ();
+    void step ();
+    void advanceTicks (int nTicks);
+    ClockState idleUntil ();
   };
 
 }
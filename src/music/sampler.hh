@@ -25,6 +25,14 @@
 namespace MUSIC {
 
   class Sampler {
+  public:
+    // Interpolation kernels write n interpolated elements to dest
+    typedef void (*Kernel) (const ContDataT* prev,
+			    const ContDataT* succ,
+			    ContDataT* dest,
+			    int n,
+			    double interpolationCoefficient);
+  private:
     DataMap* dataMap_;
     DataMap* interpolationDataMap_;
     bool hasSampled;
@@ -33,6 +41,7 @@ namespace MUSIC {
     ContDataT* interpolationData_;
     int elementSize;
     int size;
+    Kernel kernel_;
   public:
     Sampler ();
     ~Sampler ();
@@ -50,14 +59,7 @@ namespace MUSIC {
   private:
     void swapBuffers (ContDataT*& b1, ContDataT*& b2);
     void interpolateTo (DataMap* dataMap, double interpolationCoefficient);
-    void interpolate (int from,
-		      int n,
-		      double interpolationCoefficient,
-		      double* dest);
-    void interpolate (int from,
-		      int n,
-		      float interpolationCoefficient,
-		      float* dest);
+    static Kernel selectKernel (MPI::Datatype type);
   };
 
 }
@@ -26,8 +26,6 @@
 
 namespace MUSIC {
 
-  const int TRANSMITTED_INTERVALS_MAX = 10000;
-
   class SpatialNegotiationData {
     IndexInterval interval_;
     int rank_;
@@ -130,15 +128,12 @@ namespace MUSIC {
     virtual ~SpatialNegotiator ();
     void negotiateWidth ();
     int maxLocalWidth () { return maxLocalWidth_; }
-    NegotiationIterator wrapIntervals (IndexMap::iterator beg,
-				       IndexMap::iterator end,
+    NegotiationIterator wrapIntervals (const IndexInterval* beg,
+				       const IndexInterval* end,
 				       Index::Type type,
 				       int rank);
-    void send (MPI::Comm& comm, int destRank,
-	       NegotiationIntervals& intervals);
-    void receive (MPI::Comm& comm, int sourceRank,
-		  NegotiationIntervals& intervals);
-    void allToAll (std::vector<NegotiationIntervals>& out,
+    void allToAll (MPI::Comm& c,
+		   std::vector<NegotiationIntervals>& out,
 		   std::vector<NegotiationIntervals>& in);
     NegotiationIterator canonicalDistribution (int width, int nProcesses);
     void intersectToBuffers (std::vector<NegotiationIntervals>& source,
@@ -0,0 +1,67 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MUSIC_STATISTICS_HH
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace MUSIC {
+
+  // Counters of the data transferred by a subconnector, or summed
+  // over the subconnectors of a connector.  Output subconnectors
+  // count what they send and input subconnectors what they receive.
+  // Times are in seconds and buffer sizes in bytes.
+
+  struct TransferCounters {
+    long long messages;
+    long long bytes;
+    long long events;
+    double communicationTime;	// time in MPI, per maybeCommunicate
+    int bufferHighWater;
+    TransferCounters ();
+    void add (const TransferCounters& counters);
+  };
+
+  struct ConnectorStatistics {
+    std::string receiverAppName;
+    std::string receiverPortName;
+    bool output;
+    int subconnectors;
+    TransferCounters transfer;
+    double copyTime;		// time in Distributor, Collector and Sampler
+    ConnectorStatistics ();
+  };
+
+  // Statistics of one process, as returned by Runtime::statistics ()
+
+  struct Statistics {
+    int rank;			// in MPI::COMM_WORLD
+    std::string applicationName;
+    long long ticks;		// including those skipped by advance
+    double tickTime;		// total time in Runtime::tick
+    std::vector<ConnectorStatistics> connectors;
+    Statistics ();
+    void report (std::ostream& out) const;
+  };
+
+}
+
+#define MUSIC_STATISTICS_HH
+#endif
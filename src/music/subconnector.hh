@@ -21,12 +21,16 @@
 #include <mpi.h>
 
 #include <string>
+#include <vector>
 
 #include <music/synchronizer.hh>
 #include <music/FIBO.hh>
 #include <music/BIFO.hh>
+#include <music/distributor.hh>
 #include <music/event.hh>
 #include <music/message.hh>
+#include <music/message_log.hh>
+#include <music/statistics.hh>
 
 namespace MUSIC {
 
@@ -36,6 +40,41 @@ namespace MUSIC {
   const int CONT_BUFFER_MAX = SPIKE_BUFFER_MAX;
   const int MESSAGE_BUFFER_MAX = 10000;
 
+  // A small cache of persistent requests for transfers which are
+  // repeated with the same buffer, count, datatype and tag, such as
+  // the fixed-size messages of cont subconnectors.  A request is only
+  // replaced when the cache is full, so the user must make sure that
+  // at most MAX_REQUESTS of them are active at a time.
+  class PersistentRequests {
+  public:
+    static const unsigned int MAX_REQUESTS = 8;
+  private:
+    struct Entry {
+      void* buf;
+      int count;
+      MPI::Datatype type;
+      int tag;
+      MPI::Prequest request;
+    };
+    // Entries are assigned in place since MPI::Prequest is not
+    // meant to be copied
+    Entry entries_[MAX_REQUESTS];
+    unsigned int nEntries_;
+    unsigned int next_;		// entry to replace when full
+    Entry* find (void* buf, int count, MPI::Datatype type, int tag);
+    Entry& replace (void* buf, int count, MPI::Datatype type, int tag);
+  public:
+    PersistentRequests () : nEntries_ (0), next_ (0) { }
+    MPI::Prequest& send (MPI::Intercomm& comm,
+			 void* buf, int count, MPI::Datatype type,
+			 int dest, int tag);
+    MPI::Prequest& receive (MPI::Intercomm& comm,
+			    void* buf, int count, MPI::Datatype type,
+			    int source, int tag);
+    // Must be called before MPI::Finalize
+    void free ();
+  };
+
   // The subconnector is responsible for the local side of the
   // communication between two MPI processes, one for each port of a
   // port pair.  It is created in connector::connect ().
@@ -50,6 +89,11 @@ namespace MUSIC {
     int receiverRank_;
     int receiverPortCode_;
     bool flushed;
+    bool nonblocking_;
+    bool persistent_;
+    PersistentRequests requests_;
+    int protocol_;		// negotiated protocol features
+    TransferCounters counters_;
   public:
     Subconnector () { }
     Subconnector (Synchronizer* synch,
@@ -62,30 +106,76 @@ namespace MUSIC {
     virtual void initialCommunication () { }
     virtual void maybeCommunicate () = 0;
     virtual void flush (bool& dataStillFlowing) = 0;
+    // Use MPI::Isend/Irecv instead of blocking transfers
+    void setNonblocking () { nonblocking_ = true; }
+    // Use persistent requests where supported
+    void setPersistent () { persistent_ = true; }
+    void freeRequests () { requests_.free (); }
+    void setProtocol (int protocol) { protocol_ = protocol; }
     int remoteRank () const { return remoteRank_; }
     int remoteWorldRank () const { return remoteWorldRank_; }
     int receiverRank () const { return receiverRank_; }
     int receiverPortCode () const { return receiverPortCode_; }
+    // Statistics (see Runtime::statistics ())
+    void countMessage (int bytes)
+    { ++counters_.messages; counters_.bytes += bytes; }
+    void countEvents (int nEvents) { counters_.events += nEvents; }
+    void countTime (double t) { counters_.communicationTime += t; }
+    virtual int bufferHighWater () { return 0; }
+    TransferCounters counters ();
   };
   
   class OutputSubconnector : virtual public Subconnector {
+  protected:
+    std::vector<MPI::Request> pendingSends_;
+    void sendBlock (char* data,
+		    int size,
+		    MPI::Datatype type,
+		    int maxSize,
+		    int tag);
+    void sendChunk (char* data, int count, MPI::Datatype type, int tag);
+    void sendPersistent (void* data, int count, MPI::Datatype type, int tag);
+    void completeSends ();
   public:
     virtual FIBO* buffer () { return 0; }
+    // Data to send at this communication when transferred by a
+    // NeighborExchange
+    virtual void nextNeighborBlock (void*& data, int& size)
+    { data = NULL; size = 0; }
   };
   
   class BufferingOutputSubconnector : virtual public OutputSubconnector {
   protected:
     FIBO buffer_;
+    void nextBlock (void*& data, int& size);
   public:
     BufferingOutputSubconnector (int elementSize);
     FIBO* buffer () { return &buffer_; }
+    void nextNeighborBlock (void*& data, int& size);
+    int bufferHighWater () { return buffer_.highWater (); }
   };
   
   class InputSubconnector : virtual public Subconnector {
   protected:
+    // Receive pre-posted in non-blocking mode
+    MPI::Request pendingReceive_;
+    std::vector<char> receiveBuffer_;
+    static std::vector<char> scratch_;
     InputSubconnector ();
+    bool completeReceive (MPI::Status& status);
+    void postReceive (int maxSize, int tag);
+    bool preposting ();
+    int probeMessage (int tag);
+    void* scratch (int size);
   public:
     virtual BIFO* buffer () { return NULL; }
+    // Where a NeighborExchange should receive a block of size bytes,
+    // or NULL for a buffer owned by the exchange, and its
+    // notification that the block has arrived
+    virtual void* reserveNeighborBlock (int /* size */) { return NULL; }
+    virtual void deliverNeighborBlock (void* /* data */, int /* size */) { }
+    // Called after the initial exchange
+    virtual void initialNeighborDelivery () { }
   };
 
   class ContSubconnector : virtual public Subconnector {
@@ -98,6 +188,8 @@ namespace MUSIC {
   
   class ContOutputSubconnector : public BufferingOutputSubconnector,
 				 public ContSubconnector {
+    Distributor::Plan* plan_;	// non-NULL with direct sends
+    bool sendDirect_;
   public:
     ContOutputSubconnector (Synchronizer* synch,
 			    MPI::Intercomm intercomm,
@@ -105,9 +197,11 @@ namespace MUSIC {
 			    int remoteRank,
 			    int receiverPortCode,
 			    MPI::Datatype type);
+    void setDirect (Distributor::Plan* plan);
     void initialCommunication ();
     void maybeCommunicate ();
     void send ();
+    void nextNeighborBlock (void*& data, int& size);
     void flush (bool& dataStillFlowing);
   };
   
@@ -124,15 +218,32 @@ namespace MUSIC {
 			   int receiverPortCode,
 			   MPI::Datatype type);
     BIFO* buffer () { return &buffer_; }
+    int bufferHighWater () { return buffer_.highWater (); }
     void initialCommunication ();
     void maybeCommunicate ();
     void receive ();
+    void postBlockReceive ();
     void flush (bool& dataStillFlowing);
+    void* reserveNeighborBlock (int size);
+    void deliverNeighborBlock (void* data, int size);
+    void initialNeighborDelivery ();
   };
 
   class EventSubconnector : virtual public Subconnector {
   protected:
     static const int FLUSH_MARK = -1;
+    // In the compact wire format, each message holds a header
+    // followed by nEvents 32-bit time offsets from base, in units of
+    // resolution, and then the varint encoded differences between
+    // consecutive ids in increasing order.
+    struct CompactHeader {
+      double base;
+      double resolution;
+      int nEvents;		// FLUSH_MARK in the flush message
+      int flags;
+    };
+    static const int COMPACT_MORE = 1; // another message follows
+    static const int COMPACT_RAW = 2;  // events are sent as they are
   };
   
   class EventOutputSubconnector : public BufferingOutputSubconnector,
@@ -145,7 +256,13 @@ namespace MUSIC {
 			     int receiverPortCode);
     void maybeCommunicate ();
     void send ();
+    void nextNeighborBlock (void*& data, int& size);
     void flush (bool& dataStillFlowing);
+  private:
+    std::vector<char> encoded_;
+    std::vector<int> messages_;
+    void sendCompact (Event* ev, int nEvents);
+    void encode (Event* ev, int nEvents, bool more, bool raw);
   };
   
   class EventInputSubconnector : public InputSubconnector,
@@ -157,9 +274,16 @@ namespace MUSIC {
 			    int remoteRank,
 			    int receiverRank,
 			    int receiverPortCode);
+    void initialCommunication ();
     void maybeCommunicate ();
-    virtual void receive () = 0;
+    void receive ();
     virtual void flush (bool& dataStillFlowing);
+    void deliverNeighborBlock (void* data, int size);
+  protected:
+    void receiveCompact ();
+    // Where to receive a block of at most size bytes
+    virtual Event* reserve (int size);
+    virtual void deliver (Event* ev, int nEvents) = 0;
   };
 
   class EventInputSubconnectorGlobal : public EventInputSubconnector {
@@ -173,8 +297,9 @@ namespace MUSIC {
 				  int receiverRank,
 				  int receiverPortCode,
 				  EventHandlerGlobalIndex* eh);
-    void receive ();
     void flush (bool& dataStillFlowing);
+  protected:
+    void deliver (Event* ev, int nEvents);
   };
 
   class EventInputSubconnectorLocal : public EventInputSubconnector {
@@ -188,8 +313,27 @@ namespace MUSIC {
 				 int receiverRank,
 				 int receiverPortCode,
 				 EventHandlerLocalIndex* eh);
-    void receive ();
     void flush (bool& dataStillFlowing);
+  protected:
+    void deliver (Event* ev, int nEvents);
+  };
+
+  // Receives events directly into a buffer owned by the input port
+  class EventInputSubconnectorBuffer : public EventInputSubconnector {
+    FIBO* events_;
+    Event* reserved_;
+  public:
+    EventInputSubconnectorBuffer (Synchronizer* synch,
+				  MPI::Intercomm intercomm,
+				  int remoteLeader,
+				  int remoteRank,
+				  int receiverRank,
+				  int receiverPortCode,
+				  FIBO* events);
+    void flush (bool& dataStillFlowing);
+  protected:
+    Event* reserve (int size);
+    void deliver (Event* ev, int nEvents);
   };
 
   class MessageSubconnector : virtual public Subconnector {
@@ -199,14 +343,17 @@ namespace MUSIC {
   
   class MessageOutputSubconnector : public OutputSubconnector,
 				  public MessageSubconnector {
-    FIBO* buffer_;
+    MessageLog* log_;
+    int reader_;
+    std::vector<char> sendBuffer_;
   public:
     MessageOutputSubconnector (Synchronizer* synch,
 			       MPI::Intercomm intercomm,
 			       int remoteLeader,
 			       int remoteRank,
 			       int receiverPortCode,
-			       FIBO* buffer);
+			       MessageLog* log);
+    ~MessageOutputSubconnector ();
     void maybeCommunicate ();
     void send ();
     void flush (bool& dataStillFlowing);
@@ -224,6 +371,7 @@ namespace MUSIC {
 			      int receiverRank,
 			      int receiverPortCode,
 			      MessageHandler* mh);
+    void initialCommunication ();
     void maybeCommunicate ();
     void receive ();
     void flush (bool& dataStillFlowing);
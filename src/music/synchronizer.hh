@@ -62,9 +62,12 @@ namespace MUSIC {
     bool communicate_;
     
     void nextCommunication ();
+    void nextCommunication (Clock& send, Clock& receive);
+    void nextCommunicationByTicks (Clock& send, Clock& receive);
   public:
     virtual ~Synchronizer() { };
     void setLocalTime (Clock* lt);
+    double timebase () { return localTime->timebase (); }
     virtual void setSenderTickInterval (ClockState ti);
     virtual void setReceiverTickInterval (ClockState ti);
     void setMaxBuffered (int m);
@@ -75,6 +78,12 @@ namespace MUSIC {
     virtual void initialize ();
     virtual int initialBufferedTicks () { return 0; };
     bool communicate ();
+    // Earliest local time at which tick () may result in
+    // communication or an update of the schedule
+    virtual ClockState nextCommunicationTime ()
+    {
+      return localTime->integerTime ();
+    }
   };
 
 
@@ -82,6 +91,7 @@ namespace MUSIC {
   public:
     bool sample ();
     void tick ();
+    ClockState nextCommunicationTime ();
   };
 
 
@@ -89,6 +99,7 @@ namespace MUSIC {
   public:
     virtual int initialBufferedTicks ();
     void tick ();
+    ClockState nextCommunicationTime ();
   };
 
 
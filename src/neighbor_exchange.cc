@@ -0,0 +1,284 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//#define MUSIC_DEBUG 1
+#include "music/debug.hh" // Must be included first on BG/L
+
+#include "music/neighbor_exchange.hh"
+#include "music/error.hh"
+
+#include <algorithm>
+
+namespace MUSIC {
+
+  template<class T>
+  static T*
+  address (std::vector<T>& v)
+  {
+    return v.empty () ? NULL : &v[0];
+  }
+
+
+  NeighborExchange::NeighborExchange (Connector* connector,
+				      std::vector<OutputSubconnector*>& outputs,
+				      std::vector<InputSubconnector*>& inputs)
+    : synch_ (connector->synchronizer ()),
+      comm_ (connector->communicator ()),
+      graph_ (MPI_COMM_NULL),
+      sender_ (dynamic_cast<OutputConnector*> (connector) != NULL),
+      initialTransfer_ (dynamic_cast<ContConnector*> (connector) != NULL),
+      flushed_ (false),
+      outputs_ (outputs),
+      inputs_ (inputs),
+      communicationTime_ (0.0)
+  {
+    MPI::Intercomm intercomm = connector->intercommunicator ();
+    int rank = intercomm.Get_rank ();
+    int nSenders = intercomm.Get_size ();
+    int nReceivers = intercomm.Get_remote_size ();
+    if (!sender_)
+      std::swap (nSenders, nReceivers);
+
+    // Merging puts the sender side first, so that receiver rank r
+    // has rank nSenders + r in the merged communicator.  Receiver r
+    // has its control edge from sender r mod nSenders.
+    std::vector<int> sources;
+    std::vector<int> destinations;
+    if (sender_)
+      {
+	for (std::vector<OutputSubconnector*>::iterator o = outputs_.begin ();
+	     o != outputs_.end ();
+	     ++o)
+	  destinations.push_back (nSenders + (*o)->remoteRank ());
+	for (int r = rank; r < nReceivers; r += nSenders)
+	  destinations.push_back (nSenders + r);
+      }
+    else
+      {
+	for (std::vector<InputSubconnector*>::iterator i = inputs_.begin ();
+	     i != inputs_.end ();
+	     ++i)
+	  sources.push_back ((*i)->remoteRank ());
+	sources.push_back (rank % nSenders);
+      }
+
+#if MPI_VERSION >= 3
+    MPI::Intracomm merged = intercomm.Merge (!sender_);
+    MPI_Dist_graph_create_adjacent (merged,
+				    sources.size (),
+				    address (sources),
+				    MPI_UNWEIGHTED,
+				    destinations.size (),
+				    address (destinations),
+				    MPI_UNWEIGHTED,
+				    MPI_INFO_NULL,
+				    0,
+				    &graph_);
+    merged.Free ();
+#else
+    error ("neighborhood communication requires MPI 3");
+#endif
+
+    sendCounts_.assign (destinations.size (), 0);
+    sendDispls_.assign (destinations.size (), 0);
+    sendTypes_.assign (destinations.size (), MPI_BYTE);
+    receiveCounts_.assign (sources.size (), 0);
+    receiveDispls_.assign (sources.size (), 0);
+    receiveTypes_.assign (sources.size (), MPI_BYTE);
+    blocks_.resize (inputs_.size ());
+  }
+
+
+  NeighborExchange::~NeighborExchange ()
+  {
+    for (std::vector<OutputSubconnector*>::iterator o = outputs_.begin ();
+	 o != outputs_.end ();
+	 ++o)
+      delete *o;
+    for (std::vector<InputSubconnector*>::iterator i = inputs_.begin ();
+	 i != inputs_.end ();
+	 ++i)
+      delete *i;
+  }
+
+
+  bool
+  NeighborExchange::isAvailable ()
+  {
+    return MPI_VERSION >= 3;
+  }
+
+
+  void
+  NeighborExchange::initialCommunication ()
+  {
+    if (!initialTransfer_)
+      return;
+    collectBlocks ();
+    transfer (0, true);
+    for (std::vector<InputSubconnector*>::iterator i = inputs_.begin ();
+	 i != inputs_.end ();
+	 ++i)
+      (*i)->initialNeighborDelivery ();
+  }
+
+
+  void
+  NeighborExchange::maybeCommunicate ()
+  {
+    if (!flushed_ && synch_->communicate ())
+      {
+	double start = MPI::Wtime ();
+	collectBlocks ();
+	if (transfer (0, true))
+	  flushed_ = true;
+	communicationTime_ += MPI::Wtime () - start;
+      }
+  }
+
+
+  // The senders send the data remaining in their buffers, which the
+  // receivers throw away, until none of them has anything left.
+  // They then send the flush mark.
+  void
+  NeighborExchange::flush (bool& dataStillFlowing)
+  {
+    if (flushed_)
+      return;
+    int remaining = collectBlocks ();
+    if (sender_)
+      {
+	// all senders agree on whether to flush
+	comm_.Allreduce (MPI::IN_PLACE, &remaining, 1, MPI::INT, MPI::LOR);
+	transfer (remaining ? 0 : FLUSH_MARK, false);
+	flushed_ = !remaining;
+      }
+    else
+      flushed_ = transfer (0, false);
+    if (!flushed_)
+      dataStillFlowing = true;
+  }
+
+
+  void
+  NeighborExchange::freeCommunicator ()
+  {
+#if MPI_VERSION >= 3
+    if (graph_ != MPI_COMM_NULL)
+      MPI_Comm_free (&graph_);
+#endif
+  }
+
+
+  // Take the next block of each output subconnector.  Returns true
+  // if there is any data to send.
+  bool
+  NeighborExchange::collectBlocks ()
+  {
+    bool data = false;
+    for (unsigned int o = 0; o < outputs_.size (); ++o)
+      {
+	void* block;
+	int size;
+	outputs_[o]->nextNeighborBlock (block, size);
+	sendCounts_[o] = size;
+	sendDispls_[o] = 0;
+	outputs_[o]->countMessage (size);
+	if (size > 0)
+	  {
+	    MPI_Get_address (block, &sendDispls_[o]);
+	    data = true;
+	  }
+      }
+    return data;
+  }
+
+
+  // One round of communication: the block sizes are exchanged first,
+  // together with the control value on the control edges, so that
+  // the receivers can provide room for the data, which then goes
+  // directly between the subconnector buffers.  Returns true if this
+  // process received the flush mark.
+  bool
+  NeighborExchange::transfer (int control, bool deliver)
+  {
+    for (unsigned int k = outputs_.size (); k < sendCounts_.size (); ++k)
+      sendCounts_[k] = control;
+#if MPI_VERSION >= 3
+    MPI_Neighbor_alltoall (address (sendCounts_), 1, MPI_INT,
+			   address (receiveCounts_), 1, MPI_INT,
+			   graph_);
+#endif
+    for (unsigned int k = outputs_.size (); k < sendCounts_.size (); ++k)
+      sendCounts_[k] = 0;
+    bool flushMark = false;
+    if (!receiveCounts_.empty ())
+      {
+	flushMark = receiveCounts_.back () == FLUSH_MARK;
+	receiveCounts_.back () = 0;
+      }
+    deliver = deliver && !flushMark;
+
+    // Blocks which the subconnectors don't place themselves are
+    // received into buffer_
+    int total = 0;
+    for (unsigned int i = 0; i < inputs_.size (); ++i)
+      {
+	blocks_[i] = NULL;
+	if (deliver)
+	  blocks_[i] = inputs_[i]->reserveNeighborBlock (receiveCounts_[i]);
+	if (blocks_[i] == NULL)
+	  total += receiveCounts_[i];
+      }
+    if (buffer_.size () < (size_t) total)
+      buffer_.resize (total);
+    total = 0;
+    for (unsigned int i = 0; i < inputs_.size (); ++i)
+      {
+	if (blocks_[i] == NULL)
+	  {
+	    blocks_[i] = address (buffer_) + total;
+	    total += receiveCounts_[i];
+	  }
+	receiveDispls_[i] = 0;
+	if (receiveCounts_[i] > 0)
+	  MPI_Get_address (blocks_[i], &receiveDispls_[i]);
+      }
+
+#if MPI_VERSION >= 3
+    MPI_Neighbor_alltoallw (MPI_BOTTOM,
+			    address (sendCounts_),
+			    address (sendDispls_),
+			    address (sendTypes_),
+			    MPI_BOTTOM,
+			    address (receiveCounts_),
+			    address (receiveDispls_),
+			    address (receiveTypes_),
+			    graph_);
+#endif
+
+    for (unsigned int i = 0; i < inputs_.size (); ++i)
+      {
+	inputs_[i]->countMessage (receiveCounts_[i]);
+	if (deliver)
+	  inputs_[i]->deliverNeighborBlock (blocks_[i], receiveCounts_[i]);
+      }
+    return flushMark;
+  }
+
+}
@@ -24,13 +24,12 @@ namespace MUSIC {
   
   PermutationIndex::PermutationIndex (GlobalIndex* indices, int size)
   {
-    
-    // NOTE: collapse adjacent intervals where possible?
+    indices_.reserve (size);
     for (int i = 0; i < size; ++i)
       indices_.push_back (IndexInterval (indices[i],
 					 indices[i] + 1,
 					 indices[i] - i));
-    sort (indices_.begin (), indices_.end ());
+    coalesceIntervals (indices_);
   }
   
 
@@ -383,9 +383,67 @@ namespace MUSIC {
     router.insertEvent (t, id);
   }
 
+
+  // The indices are interpreted according to the index type given
+  // to map.
+  void
+  EventOutputPort::insertEvents (const double* t, const int* id, size_t n)
+  {
+    router.insertEvents (t, id, n);
+  }
+
+
+  // Events inserted with a thread number are kept in a separate
+  // buffer per thread, so no locking is needed.  They are routed
+  // when the application calls tick, which is done from a single
+  // thread.
+  void
+  EventOutputPort::setThreads (int nThreads)
+  {
+    if (nThreads <= 0)
+      error ("EventOutputPort::setThreads: nThreads should be a positive integer");
+    mergeThreadEvents ();
+    shards.resize (nThreads);
+  }
+
+
+  void
+  EventOutputPort::insertEvent (double t, GlobalIndex id, int thread)
+  {
+    shards[thread].events.push_back (Event (t, id));
+  }
+
+
+  void
+  EventOutputPort::insertEvent (double t, LocalIndex id, int thread)
+  {
+    shards[thread].events.push_back (Event (t, id));
+  }
+
+
+  void
+  EventOutputPort::mergeThreadEvents ()
+  {
+    for (std::vector<Shard>::iterator s = shards.begin ();
+	 s != shards.end ();
+	 ++s)
+      if (!s->events.empty ())
+	{
+	  router.insertEvents (&s->events[0], s->events.size ());
+	  s->events.clear ();
+	}
+  }
+
+
+  void
+  EventOutputPort::tick ()
+  {
+    mergeThreadEvents ();
+  }
+
   
   EventInputPort::EventInputPort (Setup* s, std::string id)
-    : Port (s, id)
+    : Port (s, id), buffered_ (false), events_ (sizeof (Event))
   {
   }
 
@@ -458,6 +516,72 @@ namespace MUSIC {
   }
 
   
+  void
+  EventInputPort::map (IndexMap* indices,
+		       Index::Type type,
+		       double accLatency)
+  {
+    assertInput ();
+    int maxBuffered = MAX_BUFFERED_NO_VALUE;
+    buffered_ = true;
+    mapImpl (indices,
+	     type,
+	     EventHandlerPtr (),
+	     accLatency,
+	     maxBuffered);
+  }
+
+  
+  void
+  EventInputPort::map (IndexMap* indices,
+		       Index::Type type,
+		       double accLatency,
+		       int maxBuffered)
+  {
+    assertInput ();
+    if (maxBuffered <= 0)
+      {
+	error ("EventInputPort::map: maxBuffered should be a positive integer");
+      }
+    buffered_ = true;
+    mapImpl (indices,
+	     type,
+	     EventHandlerPtr (),
+	     accLatency,
+	     maxBuffered);
+  }
+
+
+  // The events received during the last call of Runtime::tick,
+  // advance or tickUntil
+  const Event*
+  EventInputPort::events ()
+  {
+    void* data;
+    int size;
+    events_.nextBlockNoClear (data, size);
+    return static_cast<Event*> (data);
+  }
+
+
+  size_t
+  EventInputPort::nEvents ()
+  {
+    void* data;
+    int size;
+    events_.nextBlockNoClear (data, size);
+    return size / sizeof (Event);
+  }
+
+
+  void
+  EventInputPort::clearEvents ()
+  {
+    if (buffered_)
+      events_.clear ();
+  }
+
+  
   void
   EventInputPort::mapImpl (IndexMap* indices,
 			   Index::Type type,
@@ -482,7 +606,8 @@ namespace MUSIC {
 				    spatialNegotiator,
 				    handleEvent_,
 				    type_,
-				    setup_->communicator ());
+				    setup_->communicator (),
+				    buffered_ ? &events_ : NULL);
   }
 
   
@@ -515,10 +640,16 @@ namespace MUSIC {
   
   
   MessageOutputPort::MessageOutputPort (Setup* s, std::string id)
-    : Port (s, id), MessagePort (s)
+    : Port (s, id), MessagePort (s), log_ (new MessageLog ())
   {
   }
 
+
+  MessageOutputPort::~MessageOutputPort ()
+  {
+    log_->removeReference ();
+  }
+
   
   void
   MessageOutputPort::map ()
@@ -559,23 +690,17 @@ namespace MUSIC {
     return new MessageOutputConnector (connInfo,
 				       spatialNegotiator,
 				       setup_->communicator (),
-				       buffers);
+				       log_);
   }
   
   
+  // The message is stored once, regardless of the number of
+  // connections.  Subconnectors which may send at different times
+  // read it from the shared log.
   void
   MessageOutputPort::insertMessage (double t, void* msg, size_t size)
   {
-    // One output buffer per OutputConnector (since different
-    // connectors may need to send at different times)
-    for (std::vector<FIBO*>::iterator b = buffers.begin ();
-	 b != buffers.end ();
-	 ++b)
-      {
-	MessageHeader header (t, size);
-	(*b)->insert (header.data (), sizeof (MessageHeader));
-	(*b)->insert (msg, size);
-      }
+    log_->insert (t, msg, size);
   }
 
   
@@ -22,16 +22,21 @@
 #include <mpi.h>
 
 #include <algorithm>
+#include <iostream>
+#include <limits>
+#include <set>
 
 #include "music/runtime.hh"
 #include "music/temporal.hh"
 #include "music/error.hh"
+#include "music/communication.hh"
 
 namespace MUSIC {
 
   bool Runtime::isInstantiated_ = false;
 
   Runtime::Runtime (Setup* s, double h)
+    : ticks (0), tickTime (0.0), reportStatistics (false)
   {
     checkInstantiatedOnce (isInstantiated_, "Runtime");
     s->maybePostponedSetup ();
@@ -44,10 +49,14 @@ namespace MUSIC {
     
     comm = s->communicator ();
 
+    applicationName = s->config_->applicationName ();
+
     Connections* connections = s->connections ();
     
     if (s->launchedByMusic ())
       {
+	selectMemoryPolicy (s);
+	
 	takeTickingPorts (s);
 	
 	// create a total order for connectors and
@@ -59,6 +68,9 @@ namespace MUSIC {
 	
 	// from here we can start using the vector `connectors'
 
+	// agree with peers on optional protocol features
+	negotiateProtocols (s);
+
 	// negotiate where to route data and fill up subconnector vectors
 	spatialNegotiation (outputSubconnectors, inputSubconnectors);
 
@@ -72,6 +84,18 @@ namespace MUSIC {
 		       inputSubconnectors);
 	
 	takePostCommunicators ();
+
+	// blocking or non-blocking transfers
+	selectCommunicationMode (s);
+
+	// transfer cont data directly from application memory
+	selectZeroCopy (s);
+
+	// reuse MPI requests for cont transfers
+	selectPersistentRequests (s);
+
+	// report statistics at finalize
+	selectStatistics (s);
 	
 	// negotiate timing constraints for synchronizers
 	temporalNegotiation (s, connections);
@@ -92,6 +116,11 @@ namespace MUSIC {
 	 ++subconnector)
       delete *subconnector;
 
+    for (std::vector<NeighborExchange*>::iterator e = exchanges.begin ();
+	 e != exchanges.end ();
+	 ++e)
+      delete *e;
+
     // delete connectors
     for (std::vector<Connector*>::iterator connector = connectors.begin ();
 	 connector != connectors.end ();
@@ -111,6 +140,9 @@ namespace MUSIC {
 	TickingPort* tp = dynamic_cast<TickingPort*> (*p);
 	if (tp != NULL)
 	  tickingPorts.push_back (tp);
+	EventInputPort* ep = dynamic_cast<EventInputPort*> (*p);
+	if (ep != NULL)
+	  eventInputPorts.push_back (ep);
       }
   }
   
@@ -129,6 +161,146 @@ namespace MUSIC {
   }
   
 
+  // The configuration variable "communication" selects between
+  // blocking (default) and non-blocking point-to-point transfers.
+  // Both use the same messages so the choice is local to each
+  // application.  The third mode, "neighborhood", is negotiated in
+  // negotiateProtocols.
+  void
+  Runtime::selectCommunicationMode (Setup* s)
+  {
+    std::string mode;
+    if (!s->config ("communication", &mode)
+	|| mode == "blocking"
+	|| mode == "neighborhood")
+      return;
+    if (mode != "nonblocking")
+      error0 ("unknown communication mode \"" + mode + "\"");
+    for (std::vector<Subconnector*>::iterator subconnector = schedule.begin ();
+	 subconnector != schedule.end ();
+	 ++subconnector)
+      (*subconnector)->setNonblocking ();
+  }
+  
+
+  // With the configuration variable "zerocopy" set to "yes", cont
+  // data is, when possible, sent directly from application memory
+  // using MPI derived datatypes instead of being copied to the send
+  // buffers first.
+  void
+  Runtime::selectZeroCopy (Setup* s)
+  {
+    std::string zeroCopy;
+    if (!s->config ("zerocopy", &zeroCopy) || zeroCopy == "no")
+      return;
+    if (zeroCopy != "yes")
+      error0 ("zerocopy should be \"yes\" or \"no\"");
+    for (std::vector<Connector*>::iterator c = connectors.begin ();
+	 c != connectors.end ();
+	 ++c)
+      {
+	ContConnector* contConnector = dynamic_cast<ContConnector*> (*c);
+	if (contConnector != NULL)
+	  contConnector->setZeroCopy ();
+      }
+  }
+
+
+  // With the configuration variable "persistent" set to "yes", cont
+  // data is transferred using persistent requests, which are set up
+  // at the first transfer and then restarted for as long as the
+  // buffer and message size stay the same.
+  void
+  Runtime::selectPersistentRequests (Setup* s)
+  {
+    std::string persistent;
+    if (!s->config ("persistent", &persistent) || persistent == "no")
+      return;
+    if (persistent != "yes")
+      error0 ("persistent should be \"yes\" or \"no\"");
+    for (std::vector<Subconnector*>::iterator subconnector = schedule.begin ();
+	 subconnector != schedule.end ();
+	 ++subconnector)
+      if (dynamic_cast<ContSubconnector*> (*subconnector) != NULL)
+	(*subconnector)->setPersistent ();
+  }
+
+
+  // With the configuration variable "statistics" set to "yes", each
+  // process writes a report of its statistics () to standard error
+  // at finalize.  The counters are maintained regardless.
+  void
+  Runtime::selectStatistics (Setup* s)
+  {
+    std::string statistics;
+    if (!s->config ("statistics", &statistics) || statistics == "no")
+      return;
+    if (statistics != "yes")
+      error0 ("statistics should be \"yes\" or \"no\"");
+    reportStatistics = true;
+  }
+
+
+  // With the configuration variable "hugepages" set to "yes", large
+  // communication buffers are aligned to huge pages
+  void
+  Runtime::selectMemoryPolicy (Setup* s)
+  {
+    std::string hugePages;
+    if (!s->config ("hugepages", &hugePages) || hugePages == "no")
+      return;
+    if (hugePages != "yes")
+      error0 ("hugepages should be \"yes\" or \"no\"");
+    FIBO::useHugePages (true);
+  }
+
+
+  // The configuration variable "transfer" selects how blocks of data
+  // are transferred.  With "probe", each block is sent as a single
+  // message which the receiver sizes through MPI::Probe.  The default,
+  // "chunked", splits blocks into messages of bounded size.  With
+  // "eventformat" set to "compact", events are sent in the compact
+  // wire format rather than as an array of Event.  Since both sides
+  // must agree, these choices are negotiated per connector in the
+  // same order as the intercommunicators were created.  The same
+  // goes for "communication" set to "neighborhood", which is used
+  // by cont and event connectors.  Where the remote application
+  // doesn't ask for it, blocking transfers are used instead.
+  void
+  Runtime::negotiateProtocols (Setup* s)
+  {
+    int protocol = 0;
+    std::string mode;
+    if (s->config ("communication", &mode) && mode == "neighborhood")
+      {
+	if (!NeighborExchange::isAvailable ())
+	  error0 ("neighborhood communication requires MPI 3");
+	protocol |= PROTOCOL_NEIGHBORHOOD;
+      }
+    std::string transfer;
+    if (s->config ("transfer", &transfer) && transfer != "chunked")
+      {
+	if (transfer != "probe")
+	  error0 ("unknown transfer mode \"" + transfer + "\"");
+	protocol |= PROTOCOL_PROBE;
+      }
+    std::string format;
+    if (s->config ("eventformat", &format) && format != "plain")
+      {
+	if (format != "compact")
+	  error0 ("unknown event format \"" + format + "\"");
+	protocol |= PROTOCOL_COMPACT;
+      }
+    for (std::vector<Connector*>::iterator c = connectors.begin ();
+	 c != connectors.end ();
+	 ++c)
+      if (dynamic_cast<MessageConnector*> (*c) != NULL)
+	(*c)->negotiateProtocol (protocol & ~PROTOCOL_NEIGHBORHOOD);
+      else
+	(*c)->negotiateProtocol (protocol);
+  }
+
+
   // This predicate gives a total order for connectors which is the
   // same on the sender and receiver sides.  It belongs here rather
   // than in connector.hh or connector.cc since it is connected to the
@@ -199,8 +371,37 @@ namespace MUSIC {
 	 c != connectors.end ();
 	 ++c)
       {
+	OutputSubconnectors::size_type nOutput = outputSubconnectors.size ();
+	InputSubconnectors::size_type nInput = inputSubconnectors.size ();
+	
 	// negotiate and fill up vectors passed as arguments
 	(*c)->spatialNegotiation (outputSubconnectors, inputSubconnectors);
+
+	std::vector<Subconnector*> subconnectors;
+	subconnectors.insert (subconnectors.end (),
+			      outputSubconnectors.begin () + nOutput,
+			      outputSubconnectors.end ());
+	subconnectors.insert (subconnectors.end (),
+			      inputSubconnectors.begin () + nInput,
+			      inputSubconnectors.end ());
+	connectorSubconnectors.push_back (subconnectors);
+	connectorExchanges.push_back (NULL);
+
+	// The subconnectors of a connector using neighborhood
+	// collectives are handed over to a NeighborExchange instead of
+	// entering the schedule.  Both sides build it here, in
+	// connector order.
+	if ((*c)->protocol () & PROTOCOL_NEIGHBORHOOD)
+	  {
+	    OutputSubconnectors outputs (outputSubconnectors.begin () + nOutput,
+					 outputSubconnectors.end ());
+	    InputSubconnectors inputs (inputSubconnectors.begin () + nInput,
+				       inputSubconnectors.end ());
+	    outputSubconnectors.resize (nOutput);
+	    inputSubconnectors.resize (nInput);
+	    exchanges.push_back (new NeighborExchange (*c, outputs, inputs));
+	    connectorExchanges.back () = exchanges.back ();
+	  }
       }
   }
 
@@ -311,17 +512,48 @@ namespace MUSIC {
 
     // receive first chunk of data from sender application and fill
     // cont buffers according to Synchronizer::initialBufferedTicks ()
+    std::vector<NeighborExchange*>::iterator e;
+    for (e = exchanges.begin (); e != exchanges.end (); ++e)
+      (*e)->initialCommunication ();
     for (std::vector<Subconnector*>::iterator s = schedule.begin ();
 	 s != schedule.end ();
 	 ++s)
       (*s)->initialCommunication ();
 
     for (c = connectors.begin (); c != connectors.end (); ++c)
-      (*c)->prepareForSimulation ();
+      {
+	(*c)->prepareForSimulation ();
+	if ((*c)->idleBetweenCommunications ())
+	  idleConnectors.push_back (*c);
+	else
+	  activeConnectors.push_back (*c);
+      }
+
+    // Subconnectors of idle connectors are skipped along with them.
+    // Their synchronizers keep the decision of the last tick where
+    // they were ticked, so they must not be asked to communicate at
+    // ticks where they are not.
+    std::set<Subconnector*> active;
+    for (unsigned int i = 0; i < connectors.size (); ++i)
+      if (!connectors[i]->idleBetweenCommunications ())
+	{
+	  active.insert (connectorSubconnectors[i].begin (),
+			 connectorSubconnectors[i].end ());
+	  if (connectorExchanges[i] != NULL)
+	    activeExchanges.push_back (connectorExchanges[i]);
+	}
+    for (std::vector<Subconnector*>::iterator s = schedule.begin ();
+	 s != schedule.end ();
+	 ++s)
+      if (active.find (*s) != active.end ())
+	activeSchedule.push_back (*s);
 
     // compensate for first localTime.tick () in Runtime::tick ()
     localTime.ticks (-1);
 
+    // tick all connectors at the first tick
+    nextIdleTick = localTime.integerTime ();
+
     // the time zero tick () (where we may or may not communicate)
     tick ();
   }
@@ -330,16 +562,46 @@ namespace MUSIC {
   void
   Runtime::finalize ()
   {
+    // Route events inserted by threads since the last tick
+    std::vector<TickingPort*>::iterator p;
+    for (p = tickingPorts.begin (); p != tickingPorts.end (); ++p)
+      {
+	EventOutputPort* port = dynamic_cast<EventOutputPort*> (*p);
+	if (port != NULL)
+	  port->mergeThreadEvents ();
+      }
+    
     bool dataStillFlowing;
     do
       {
 	dataStillFlowing = false;
+	std::vector<NeighborExchange*>::iterator e;
+	for (e = exchanges.begin (); e != exchanges.end (); ++e)
+	  (*e)->flush (dataStillFlowing);
 	std::vector<Subconnector*>::iterator c;
 	for (c = schedule.begin (); c != schedule.end (); ++c)
 	  (*c)->flush (dataStillFlowing);
       }
     while (dataStillFlowing);
 
+    for (std::vector<Subconnector*>::iterator c = schedule.begin ();
+	 c != schedule.end ();
+	 ++c)
+      (*c)->freeRequests ();
+
+    // with zerocopy, sends use derived datatypes
+    for (std::vector<Connector*>::iterator c = connectors.begin ();
+	 c != connectors.end ();
+	 ++c)
+      {
+	ContOutputConnector* contOutput = dynamic_cast<ContOutputConnector*> (*c);
+	if (contOutput != NULL)
+	  contOutput->freeDatatypes ();
+      }
+
+    if (reportStatistics)
+      statistics ().report (std::cerr);
+
 #if defined (OPEN_MPI) && MPI_VERSION <= 2
     // This is needed in OpenMPI version <= 1.2 for the freeing of the
     // intercommunicators to go well
@@ -350,6 +612,10 @@ namespace MUSIC {
 	 connector != connectors.end ();
 	 ++connector)
       (*connector)->freeIntercomm ();
+    for (std::vector<NeighborExchange*>::iterator e = exchanges.begin ();
+	 e != exchanges.end ();
+	 ++e)
+      (*e)->freeCommunicator ();
     
     MPI::Finalize ();
   }
@@ -358,6 +624,27 @@ namespace MUSIC {
   void
   Runtime::tick ()
   {
+    clearEvents ();
+    step ();
+  }
+
+
+  // Events buffered in ports for the application are kept until the
+  // next call of tick, advance or tickUntil
+  void
+  Runtime::clearEvents ()
+  {
+    std::vector<EventInputPort*>::iterator p;
+    for (p = eventInputPorts.begin (); p != eventInputPorts.end (); ++p)
+      (*p)->clearEvents ();
+  }
+
+
+  void
+  Runtime::step ()
+  {
+    double start = MPI::Wtime ();
+    
     // Update local time
     localTime.tick ();
     
@@ -369,18 +656,46 @@ namespace MUSIC {
     // Check if any connector wants to communicate
     bool requestCommunication = false;
 
+    // Connectors which are idle between communications are skipped
+    // until the first of them may communicate
     std::vector<Connector*>::iterator c;
-    for (c = connectors.begin (); c != connectors.end (); ++c)
-      (*c)->tick (requestCommunication);
+    bool tickIdle = localTime.integerTime () >= nextIdleTick;
+    if (tickIdle)
+      {
+	for (c = connectors.begin (); c != connectors.end (); ++c)
+	  (*c)->tick (requestCommunication);
+	nextIdleTick = idleUntil ();
+      }
+    else
+      for (c = activeConnectors.begin (); c != activeConnectors.end (); ++c)
+	(*c)->tick (requestCommunication);
 
     // Communicate data through non-interlocking pair-wise exchange
     if (requestCommunication)
       {
+	std::vector<NeighborExchange*>& tickExchanges
+	  = tickIdle ? exchanges : activeExchanges;
+	std::vector<Subconnector*>& tickSchedule
+	  = tickIdle ? schedule : activeSchedule;
+
+	// Neighborhood collectives go first, in the same connector
+	// order in all processes
+	for (std::vector<NeighborExchange*>::iterator e = tickExchanges.begin ();
+	     e != tickExchanges.end ();
+	     ++e)
+	  (*e)->maybeCommunicate ();
+	
 	// Loop through the schedule of subconnectors
-	for (std::vector<Subconnector*>::iterator s = schedule.begin ();
-	     s != schedule.end ();
+	double t = MPI::Wtime ();
+	for (std::vector<Subconnector*>::iterator s = tickSchedule.begin ();
+	     s != tickSchedule.end ();
 	     ++s)
-	  (*s)->maybeCommunicate ();
+	  {
+	    (*s)->maybeCommunicate ();
+	    double now = MPI::Wtime ();
+	    (*s)->countTime (now - t);
+	    t = now;
+	  }
       }
 
     // ContInputConnectors write data to application here
@@ -389,14 +704,135 @@ namespace MUSIC {
 	 c != postCommunication.end ();
 	 ++c)
       (*c)->postCommunication ();
-	
+
+    ++ticks;
+    tickTime += MPI::Wtime () - start;
+  }
+
+
+  // Equivalent to nTicks calls of tick (), except that events
+  // buffered in ports accumulate over all ticks.
+  void
+  Runtime::advance (int nTicks)
+  {
+    clearEvents ();
+    advanceTicks (nTicks);
   }
 
 
+  // When all connectors are idle between communications, ticks before
+  // the next communication only advance the clock and are skipped,
+  // except that the last tick is always performed.
+  void
+  Runtime::advanceTicks (int nTicks)
+  {
+    while (nTicks > 0)
+      {
+	if (activeConnectors.empty () && postCommunication.empty ())
+	  {
+	    ClockState ahead = nextIdleTick - localTime.integerTime ();
+	    long long skip = nTicks - 1;
+	    if (ahead <= skip * localTime.tickInterval ())
+	      skip = (ahead - 1) / localTime.tickInterval ();
+	    if (skip > 0)
+	      {
+		localTime.ticks (skip);
+		ticks += skip;
+		nTicks -= skip;
+	      }
+	  }
+	step ();
+	--nTicks;
+      }
+  }
+
+
+  // Equivalent to calling tick () while time () < t, except that
+  // events buffered in ports accumulate over all ticks
+  void
+  Runtime::tickUntil (double t)
+  {
+    clearEvents ();
+    // Ticks which safely end before t, given the rounding in
+    // ClockState, are done in one batch
+    ClockState target (t, localTime.timebase ());
+    long long nTicks = ((target - 2 - localTime.integerTime ())
+			/ localTime.tickInterval ());
+    if (nTicks > 0)
+      advanceTicks (std::min (nTicks,
+			      (long long) std::numeric_limits<int>::max ()));
+    while (time () < t)
+      step ();
+  }
+
+  
   double
   Runtime::time ()
   {
     return localTime.time ();
   }
+
+
+  ClockState
+  Runtime::idleUntil ()
+  {
+    ClockState t = std::numeric_limits<long long>::max ();
+    for (std::vector<Connector*>::iterator c = idleConnectors.begin ();
+	 c != idleConnectors.end ();
+	 ++c)
+      t = std::min (t, (*c)->synchronizer ()->nextCommunicationTime ());
+    return t;
+  }
+
+
+  Statistics
+  Runtime::statistics ()
+  {
+    Statistics statistics;
+    statistics.rank = MPI::COMM_WORLD.Get_rank ();
+    statistics.applicationName = applicationName;
+    statistics.ticks = ticks;
+    statistics.tickTime = tickTime;
+    for (unsigned int i = 0; i < connectorSubconnectors.size (); ++i)
+      {
+	ConnectorStatistics c;
+	c.receiverAppName = connectors[i]->receiverAppName ();
+	c.receiverPortName = connectors[i]->receiverPortName ();
+	c.output = dynamic_cast<OutputConnector*> (connectors[i]) != NULL;
+	std::vector<Subconnector*>& subconnectors = connectorSubconnectors[i];
+	c.subconnectors = subconnectors.size ();
+	for (std::vector<Subconnector*>::iterator s = subconnectors.begin ();
+	     s != subconnectors.end ();
+	     ++s)
+	  c.transfer.add ((*s)->counters ());
+	if (connectorExchanges[i] != NULL)
+	  c.transfer.communicationTime
+	    += connectorExchanges[i]->communicationTime ();
+	ContConnector* contConnector = dynamic_cast<ContConnector*> (connectors[i]);
+	if (contConnector != NULL)
+	  c.copyTime = contConnector->copyTime ();
+	statistics.connectors.push_back (c);
+      }
+    return statistics;
+  }
+
+
+  // Earliest time at which any connector may communicate
+  double
+  Runtime::nextCommunicationTime ()
+  {
+    ClockState t = std::numeric_limits<long long>::max ();
+    for (std::vector<Connector*>::iterator c = connectors.begin ();
+	 c != connectors.end ();
+	 ++c)
+      {
+	Synchronizer* synch = (*c)->synchronizer ();
+	if (synch != NULL)
+	  t = std::min (t, synch->nextCommunicationTime ());
+      }
+    if (t == std::numeric_limits<long long>::max ())
+      return std::numeric_limits<double>::infinity ();
+    return t * localTime.timebase ();
+  }
   
 }
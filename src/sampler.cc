@@ -30,10 +30,214 @@
 
 #include "music/sampler.hh"
 
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define MUSIC_X86_KERNELS
+#include <immintrin.h>
+// Products must not be fused into FMA instructions since this would
+// change the results
+#ifdef __clang__
+#define MUSIC_KERNEL(isa) __attribute__ ((target (isa)))
+#else
+#define MUSIC_KERNEL(isa) \
+  __attribute__ ((target (isa), optimize ("fp-contract=off")))
+#endif
+#endif
+
 namespace MUSIC {
 
+  /*
+   * Interpolation kernels
+   *
+   * All kernels evaluate (1 - c) * prev + c * succ with the same
+   * operations as the portable loops, so that they give identical
+   * results.  For float data, c is a float and the product c * succ
+   * is formed in single precision.  The SIMD kernels are compiled
+   * for their instruction set only and chosen at run time by
+   * Sampler::selectKernel.
+   */
+
+  static void
+  interpolateDoublePortable (const ContDataT* prevData,
+			     const ContDataT* succData,
+			     ContDataT* destData,
+			     int n,
+			     double c)
+  {
+    const double* prev = reinterpret_cast<const double*> (prevData);
+    const double* succ = reinterpret_cast<const double*> (succData);
+    double* dest = reinterpret_cast<double*> (destData);
+    for (int i = 0; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+
+  static void
+  interpolateFloatPortable (const ContDataT* prevData,
+			    const ContDataT* succData,
+			    ContDataT* destData,
+			    int n,
+			    double interpolationCoefficient)
+  {
+    const float* prev = reinterpret_cast<const float*> (prevData);
+    const float* succ = reinterpret_cast<const float*> (succData);
+    float* dest = reinterpret_cast<float*> (destData);
+    float c = interpolationCoefficient;
+    for (int i = 0; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+#ifdef MUSIC_X86_KERNELS
+
+  MUSIC_KERNEL ("sse2") static void
+  interpolateDoubleSSE2 (const ContDataT* prevData,
+			 const ContDataT* succData,
+			 ContDataT* destData,
+			 int n,
+			 double c)
+  {
+    const double* prev = reinterpret_cast<const double*> (prevData);
+    const double* succ = reinterpret_cast<const double*> (succData);
+    double* dest = reinterpret_cast<double*> (destData);
+    __m128d a = _mm_set1_pd (1.0 - c);
+    __m128d b = _mm_set1_pd (c);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+      _mm_storeu_pd (dest + i,
+		     _mm_add_pd (_mm_mul_pd (a, _mm_loadu_pd (prev + i)),
+				 _mm_mul_pd (b, _mm_loadu_pd (succ + i))));
+    for (; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+
+  MUSIC_KERNEL ("sse2") static void
+  interpolateFloatSSE2 (const ContDataT* prevData,
+			const ContDataT* succData,
+			ContDataT* destData,
+			int n,
+			double interpolationCoefficient)
+  {
+    const float* prev = reinterpret_cast<const float*> (prevData);
+    const float* succ = reinterpret_cast<const float*> (succData);
+    float* dest = reinterpret_cast<float*> (destData);
+    float c = interpolationCoefficient;
+    __m128d a = _mm_set1_pd (1.0 - c);
+    __m128 b = _mm_set1_ps (c);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+	__m128 p = _mm_loadu_ps (prev + i);
+	__m128 s = _mm_mul_ps (b, _mm_loadu_ps (succ + i));
+	__m128d lo = _mm_add_pd (_mm_mul_pd (a, _mm_cvtps_pd (p)),
+				 _mm_cvtps_pd (s));
+	__m128d hi = _mm_add_pd (_mm_mul_pd (a, _mm_cvtps_pd (_mm_movehl_ps (p, p))),
+				 _mm_cvtps_pd (_mm_movehl_ps (s, s)));
+	_mm_storeu_ps (dest + i,
+		       _mm_movelh_ps (_mm_cvtpd_ps (lo), _mm_cvtpd_ps (hi)));
+      }
+    for (; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+
+  MUSIC_KERNEL ("avx2") static void
+  interpolateDoubleAVX2 (const ContDataT* prevData,
+			 const ContDataT* succData,
+			 ContDataT* destData,
+			 int n,
+			 double c)
+  {
+    const double* prev = reinterpret_cast<const double*> (prevData);
+    const double* succ = reinterpret_cast<const double*> (succData);
+    double* dest = reinterpret_cast<double*> (destData);
+    __m256d a = _mm256_set1_pd (1.0 - c);
+    __m256d b = _mm256_set1_pd (c);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+      _mm256_storeu_pd (dest + i,
+			_mm256_add_pd (_mm256_mul_pd (a, _mm256_loadu_pd (prev + i)),
+				       _mm256_mul_pd (b, _mm256_loadu_pd (succ + i))));
+    for (; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+
+  MUSIC_KERNEL ("avx2") static void
+  interpolateFloatAVX2 (const ContDataT* prevData,
+			const ContDataT* succData,
+			ContDataT* destData,
+			int n,
+			double interpolationCoefficient)
+  {
+    const float* prev = reinterpret_cast<const float*> (prevData);
+    const float* succ = reinterpret_cast<const float*> (succData);
+    float* dest = reinterpret_cast<float*> (destData);
+    float c = interpolationCoefficient;
+    __m256d a = _mm256_set1_pd (1.0 - c);
+    __m128 b = _mm_set1_ps (c);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+      {
+	__m256d p = _mm256_cvtps_pd (_mm_loadu_ps (prev + i));
+	__m256d s = _mm256_cvtps_pd (_mm_mul_ps (b, _mm_loadu_ps (succ + i)));
+	_mm_storeu_ps (dest + i,
+		       _mm256_cvtpd_ps (_mm256_add_pd (_mm256_mul_pd (a, p), s)));
+      }
+    for (; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+
+  MUSIC_KERNEL ("avx512f") static void
+  interpolateDoubleAVX512 (const ContDataT* prevData,
+			   const ContDataT* succData,
+			   ContDataT* destData,
+			   int n,
+			   double c)
+  {
+    const double* prev = reinterpret_cast<const double*> (prevData);
+    const double* succ = reinterpret_cast<const double*> (succData);
+    double* dest = reinterpret_cast<double*> (destData);
+    __m512d a = _mm512_set1_pd (1.0 - c);
+    __m512d b = _mm512_set1_pd (c);
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+      _mm512_storeu_pd (dest + i,
+			_mm512_add_pd (_mm512_mul_pd (a, _mm512_loadu_pd (prev + i)),
+				       _mm512_mul_pd (b, _mm512_loadu_pd (succ + i))));
+    for (; i < n; ++i)
+      dest[i] = (1.0 - c) * prev[i] + c * succ[i];
+  }
+
+#endif // MUSIC_X86_KERNELS
+
+
+  // Choose the kernel for the data type and the widest instruction
+  // set supported by the processor.  Returns NULL for types which
+  // cannot be interpolated.
+  Sampler::Kernel
+  Sampler::selectKernel (MPI::Datatype type)
+  {
+    bool isDouble = type == MPI::DOUBLE;
+    if (!isDouble && type != MPI::FLOAT)
+      return NULL;
+#ifdef MUSIC_X86_KERNELS
+    __builtin_cpu_init ();
+    // Float data is interpolated by the AVX2 kernel also on AVX-512
+    // processors
+    if (isDouble && __builtin_cpu_supports ("avx512f"))
+      return interpolateDoubleAVX512;
+    if (__builtin_cpu_supports ("avx2"))
+      return isDouble ? interpolateDoubleAVX2 : interpolateFloatAVX2;
+    if (__builtin_cpu_supports ("sse2"))
+      return isDouble ? interpolateDoubleSSE2 : interpolateFloatSSE2;
+#endif
+    return isDouble ? interpolateDoublePortable : interpolateFloatPortable;
+  }
+
+  
   Sampler::Sampler ()
-    : dataMap_ (0), interpolationDataMap_ (0)
+    : dataMap_ (0), interpolationDataMap_ (0), kernel_ (NULL)
   {
   }
 
@@ -54,6 +258,7 @@ namespace MUSIC {
   Sampler::configure (DataMap* dataMap)
   {
     dataMap_ = dataMap->copy ();
+    kernel_ = selectKernel (dataMap_->type ());
   }
 
 
@@ -65,9 +270,8 @@ namespace MUSIC {
     size = 0;
     IndexMap* indices = dataMap_->indexMap ();
     IndexMapFactory newIndices;
-    for (IndexMap::iterator i = indices->begin ();
-	 i != indices->end ();
-	 ++i)
+    const IndexInterval* end = indices->data () + indices->size ();
+    for (const IndexInterval* i = indices->data (); i != end; ++i)
       {
 	int localIndex = size;
 	newIndices.add (i->begin (), i->end (), localIndex);
@@ -127,9 +331,8 @@ namespace MUSIC {
 
     int pos = 0;
     IndexMap* indices = dataMap_->indexMap ();
-    for (IndexMap::iterator i = indices->begin ();
-	 i != indices->end ();
-	 ++i)
+    const IndexInterval* end = indices->data () + indices->size ();
+    for (const IndexInterval* i = indices->data (); i != end; ++i)
       {
 	ContDataT* src = static_cast<ContDataT*> (dataMap_->base ());
 	int iSize = elementSize * (i->end () - i->begin ());
@@ -176,60 +379,27 @@ namespace MUSIC {
   void
   Sampler::interpolateTo (DataMap* dataMap, double interpolationCoefficient)
   {
+    if (kernel_ == NULL)
+      error ("internal error in Sampler::interpolateTo");
+    ContDataT* base = static_cast<ContDataT*> (dataMap->base ());
     int pos = 0;
     IndexMap* indices = dataMap->indexMap ();
-    for (IndexMap::iterator i = indices->begin ();
-	 i != indices->end ();
-	 ++i)
+    const IndexInterval* end = indices->data () + indices->size ();
+    for (const IndexInterval* i = indices->data (); i != end; ++i)
       {
 	int localIndex = i->begin () - i->local ();
 	int iSize = i->end () - i->begin ();
-	if (dataMap->type () == MPI::DOUBLE)
-	  interpolate (pos, iSize, interpolationCoefficient,
-		       static_cast<double*> (dataMap->base ()) + localIndex);
-	else if (dataMap->type () == MPI::FLOAT)
-	  interpolate (pos, iSize, interpolationCoefficient,
-		       static_cast<float*> (dataMap->base ()) + localIndex);
-	else
-	  error ("internal error in Sampler::interpolateTo");
+	MUSIC_LOGR ("interpolate to dest = "
+		    << static_cast<void*> (base + elementSize * localIndex)
+		    << ", begin = " << pos
+		    << ", length = " << iSize);
+	(*kernel_) (prevSample_ + elementSize * pos,
+		    sample_ + elementSize * pos,
+		    base + elementSize * localIndex,
+		    iSize,
+		    interpolationCoefficient);
 	pos += iSize;
       }    
   }
-
-
-  void
-  Sampler::interpolate (int from,
-			int n,
-			double interpolationCoefficient,
-			double* dest)
-  {
-    MUSIC_LOGR ("interpolate to dest = " << static_cast<void*> (dest)
-		<< ", begin = " << from
-		<< ", length = " << n);
-    double* prev = (static_cast<double*> (static_cast<void*> (prevSample_))
-		    + from);
-    double* succ = (static_cast<double*> (static_cast<void*> (sample_))
-		    + from);
-    for (int i = 0; i < n; ++i)
-      dest[i] = ((1.0 - interpolationCoefficient) * prev[i]
-		 + interpolationCoefficient * succ[i]);
-  }
-			
-  
-  void
-  Sampler::interpolate (int from,
-			int n,
-			float interpolationCoefficient,
-			float* dest)
-  {
-    float* prev = (static_cast<float*> (static_cast<void*> (prevSample_))
-		    + from);
-    float* succ = (static_cast<float*> (static_cast<void*> (sample_))
-		    + from);
-    for (int i = 0; i < n; ++i)
-      dest[i] = ((1.0 - interpolationCoefficient) * prev[i]
-		 + interpolationCoefficient * succ[i]);
-  }
-			
   
 }
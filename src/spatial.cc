@@ -20,6 +20,7 @@
 
 #include "music/spatial.hh" // Must be included first on BG/L
 
+#include <algorithm>
 #include <sstream>
 
 #include "music/debug.hh"
@@ -153,9 +154,8 @@ namespace MUSIC {
     // First determine local least upper bound and width
     int u = 0;
     int w = 0;
-    for (IndexMap::iterator i = indices->begin ();
-	 i != indices->end ();
-	 ++i)
+    const IndexInterval* end = indices->data () + indices->size ();
+    for (const IndexInterval* i = indices->data (); i != end; ++i)
       {
 	if (i->end () > u)
 	  u = i->end ();
@@ -257,22 +257,22 @@ namespace MUSIC {
 
   
   NegotiationIterator
-  SpatialNegotiator::wrapIntervals (IndexMap::iterator beg,
-				    IndexMap::iterator end,
+  SpatialNegotiator::wrapIntervals (const IndexInterval* beg,
+				    const IndexInterval* end,
 				    Index::Type type,
 				    int rank)
   {
     class Wrapper : public NegotiationIterator::Implementation {
     protected:
       SpatialNegotiationData data;
-      IndexMap::iterator i;
+      const IndexInterval* i;
     private:
-      IndexMap::iterator end_;
+      const IndexInterval* end_;
     protected:
       int rank_;
     public:
-      Wrapper (IndexMap::iterator beg,
-	       IndexMap::iterator end,
+      Wrapper (const IndexInterval* beg,
+	       const IndexInterval* end,
 	       int rank)
 	: i (beg), end_ (end), rank_ (rank)
       {
@@ -283,8 +283,8 @@ namespace MUSIC {
 
     class GlobalWrapper : public Wrapper {
     public:
-      GlobalWrapper (IndexMap::iterator beg,
-		     IndexMap::iterator end,
+      GlobalWrapper (const IndexInterval* beg,
+		     const IndexInterval* end,
 		     int rank)
 	: Wrapper (beg, end, rank)
       {
@@ -303,8 +303,8 @@ namespace MUSIC {
   
     class LocalWrapper : public Wrapper {
     public:
-      LocalWrapper (IndexMap::iterator beg,
-		    IndexMap::iterator end,
+      LocalWrapper (const IndexInterval* beg,
+		    const IndexInterval* end,
 		    int rank)
 	: Wrapper (beg, end, rank)
       {
@@ -329,9 +329,144 @@ namespace MUSIC {
   }
 
   
+  // An interval taking part in the sweep, tagged with the buffer it
+  // came from.
+  class SweepInterval {
+  public:
+    SpatialNegotiationData data;
+    int buffer;
+    SweepInterval (const SpatialNegotiationData& d, int b)
+      : data (d), buffer (b) { }
+    bool operator< (const SweepInterval& other) const
+    {
+      if (data.begin () != other.data.begin ())
+	return data.begin () < other.data.begin ();
+      return buffer < other.buffer;
+    }
+  };
+
+
+  // An intersection produced by the sweep together with the rank it
+  // belongs to and the buffers of the intervals it was computed from.
+  class SweepIntersection {
+  public:
+    SpatialNegotiationData data;
+    int destRank;
+    int destBuffer;
+    int sourceBuffer;
+    SweepIntersection () { }
+    SweepIntersection (const SpatialNegotiationData& d,
+		       int r, int db, int sb)
+      : data (d), destRank (r), destBuffer (db), sourceBuffer (sb) { }
+  };
+
+
+  // Stable counting sort of intersections on sourceBuffer
+  // (bySource = true) or destBuffer
+  static void
+  sortSweepIntersections (std::vector<SweepIntersection>& intersections,
+			  int nBuffers,
+			  bool bySource)
+  {
+    std::vector<int> start (nBuffers + 1, 0);
+    for (unsigned int i = 0; i < intersections.size (); ++i)
+      ++start[1 + (bySource
+		   ? intersections[i].sourceBuffer
+		   : intersections[i].destBuffer)];
+    for (int b = 0; b < nBuffers; ++b)
+      start[b + 1] += start[b];
+    std::vector<SweepIntersection> sorted (intersections.size ());
+    for (unsigned int i = 0; i < intersections.size (); ++i)
+      sorted[start[bySource
+		   ? intersections[i].sourceBuffer
+		   : intersections[i].destBuffer]++] = intersections[i];
+    intersections.swap (sorted);
+  }
+
+
+  // Gather the intervals of all buffers, joining adjacent intervals
+  // in the same way as NegotiationIterator, and sort them on begin.
+  // Since each buffer is already sorted, this is done by merging
+  // the buffers pairwise.
+  static void
+  collectSweepIntervals (std::vector<NegotiationIntervals>& buffers,
+			 std::vector<SweepInterval>& intervals)
+  {
+    std::vector<unsigned int> runs;
+    for (unsigned int b = 0; b < buffers.size (); ++b)
+      {
+	unsigned int first = intervals.size ();
+	runs.push_back (first);
+	for (NegotiationIntervals::iterator i = buffers[b].begin ();
+	     i != buffers[b].end ();
+	     ++i)
+	  if (intervals.size () > first
+	      && i->begin () == intervals.back ().data.end ()
+	      && i->local () == intervals.back ().data.local ()
+	      && i->rank () == intervals.back ().data.rank ())
+	    // join intervals
+	    intervals.back ().data.setEnd (i->end ());
+	  else
+	    intervals.push_back (SweepInterval (*i, b));
+      }
+    runs.push_back (intervals.size ());
+    while (runs.size () > 2)
+      {
+	std::vector<unsigned int> merged;
+	unsigned int r;
+	for (r = 0; r + 2 < runs.size (); r += 2)
+	  {
+	    std::inplace_merge (intervals.begin () + runs[r],
+				intervals.begin () + runs[r + 1],
+				intervals.begin () + runs[r + 2]);
+	    merged.push_back (runs[r]);
+	  }
+	for (; r < runs.size (); ++r)
+	  merged.push_back (runs[r]);
+	runs.swap (merged);
+      }
+  }
+
+
+  // Remove intervals which end at or before pos
+  static void
+  expireSweepIntervals (std::vector<SweepInterval>& active, int pos)
+  {
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < active.size (); ++i)
+      if (active[i].data.end () > pos)
+	active[n++] = active[i];
+    active.erase (active.begin () + n, active.end ());
+  }
+
+
+  static void
+  intersectSweepIntervals (const SweepInterval& s,
+			   const SweepInterval& d,
+			   std::vector<SweepIntersection>& intersections)
+  {
+    SpatialNegotiationData i (std::max (s.data.begin (), d.data.begin ()),
+			      std::min (s.data.end (), d.data.end ()),
+			      d.data.local () - s.data.local (),
+			      s.data.rank ());
+    intersections.push_back (SweepIntersection (i,
+						d.data.rank (),
+						d.buffer,
+						s.buffer));
+  }
+
+  
   // Compute intersection intervals between source and dest.  Store
   // the resulting intervals with rank from source in buffer
   // belonging to rank in dest.
+  //
+  // All intervals are sorted on begin and swept from left to right
+  // while keeping track of the source and dest intervals covering
+  // the current position, so that the work is proportional to the
+  // total number of intervals and intersections rather than to the
+  // number of buffer pairs.  The intersections are finally ordered
+  // as if each dest buffer had been intersected with each source
+  // buffer in turn.
   void
   SpatialNegotiator::intersectToBuffers
   (std::vector<NegotiationIntervals>& source,
@@ -343,13 +478,41 @@ namespace MUSIC {
 	 i != buffers.end ();
 	 ++i)
       i->clear ();
-    for (std::vector<NegotiationIntervals>::iterator d = dest.begin ();
-	 d != dest.end ();
-	 ++d)
-      for (std::vector<NegotiationIntervals>::iterator s = source.begin ();
-	   s != source.end ();
-	   ++s)
-	intersectToBuffers2 (*s, *d, buffers);
+
+    std::vector<SweepInterval> s;
+    std::vector<SweepInterval> d;
+    collectSweepIntervals (source, s);
+    collectSweepIntervals (dest, d);
+
+    std::vector<SweepInterval> activeSource;
+    std::vector<SweepInterval> activeDest;
+    std::vector<SweepIntersection> intersections;
+    unsigned int si = 0;
+    unsigned int di = 0;
+    while (si < s.size () || di < d.size ())
+      if (di == d.size ()
+	  || (si < s.size () && s[si].data.begin () <= d[di].data.begin ()))
+	{
+	  expireSweepIntervals (activeDest, s[si].data.begin ());
+	  for (unsigned int i = 0; i < activeDest.size (); ++i)
+	    intersectSweepIntervals (s[si], activeDest[i], intersections);
+	  activeSource.push_back (s[si++]);
+	}
+      else
+	{
+	  expireSweepIntervals (activeSource, d[di].data.begin ());
+	  for (unsigned int i = 0; i < activeSource.size (); ++i)
+	    intersectSweepIntervals (activeSource[i], d[di], intersections);
+	  activeDest.push_back (d[di++]);
+	}
+
+    // The sweep produces intersections in order of begin
+    sortSweepIntersections (intersections, source.size (), true);
+    sortSweepIntersections (intersections, dest.size (), false);
+    for (std::vector<SweepIntersection>::iterator i = intersections.begin ();
+	 i != intersections.end ();
+	 ++i)
+      buffers[i->destRank].push_back (i->data);
   }
 
   
@@ -434,73 +597,51 @@ namespace MUSIC {
   }
 
 
+  // Exchange interval buffers with all processes of c, which may be
+  // an intercommunicator, using one collective for the counts and
+  // one for the data.  out and in have one buffer per process of the
+  // (remote) group.
   void
-  SpatialNegotiator::send (MPI::Comm& comm,
-			   int destRank,
-			   NegotiationIntervals& intervals)
+  SpatialNegotiator::allToAll (MPI::Comm& c,
+			       std::vector<NegotiationIntervals>& out,
+			       std::vector<NegotiationIntervals>& in)
   {
-    SpatialNegotiationData* data = &intervals[0];
-    int nIntervals = intervals.size ();
-    while (nIntervals >= TRANSMITTED_INTERVALS_MAX)
+    const int k = sizeof (SpatialNegotiationData) / sizeof (int);
+    unsigned int n = out.size ();
+    if (in.size () != n)
+      error ("internal error in SpatialNegotiator::allToAll ()");
+    std::vector<int> sendCounts (n);
+    std::vector<int> sendDispls (n);
+    std::vector<int> recvCounts (n);
+    std::vector<int> recvDispls (n);
+    int nOut = 0;
+    for (unsigned int i = 0; i < n; ++i)
       {
-	comm.Send (data,
-		   sizeof (SpatialNegotiationData) / sizeof (int) * nIntervals,
-		   MPI::INT,
-		   destRank,
-		   SPATIAL_NEGOTIATION_MSG);
-	data += TRANSMITTED_INTERVALS_MAX;
-	nIntervals -= TRANSMITTED_INTERVALS_MAX;
+	sendCounts[i] = k * out[i].size ();
+	sendDispls[i] = k * nOut;
+	nOut += out[i].size ();
       }
-    comm.Send (data,
-	       sizeof (SpatialNegotiationData) / sizeof (int) * nIntervals,
-	       MPI::INT,
-	       destRank,
-	       SPATIAL_NEGOTIATION_MSG);
-  }
-
-
-  void
-  SpatialNegotiator::receive (MPI::Comm& comm,
-			      int sourceRank,
-			      NegotiationIntervals& intervals)
-  {
-    MPI::Status status;
-    int nReceived;
-    int nextPos = 0;
-    do
+    // At least one element so that the buffers have an address
+    NegotiationIntervals sendBuffer (std::max (nOut, 1));
+    for (unsigned int i = 0; i < n; ++i)
+      std::copy (out[i].begin (), out[i].end (),
+		 sendBuffer.begin () + sendDispls[i] / k);
+    c.Alltoall (&sendCounts[0], 1, MPI::INT, &recvCounts[0], 1, MPI::INT);
+    int nIn = 0;
+    for (unsigned int i = 0; i < n; ++i)
       {
-	intervals.resize (nextPos + TRANSMITTED_INTERVALS_MAX);
-	comm.Recv (&intervals[nextPos],
-		   sizeof (SpatialNegotiationData) / sizeof (int)
-		   * TRANSMITTED_INTERVALS_MAX,
-		   MPI::INT,
-		   sourceRank,
-		   SPATIAL_NEGOTIATION_MSG,
-		   status);
-	nReceived = (status.Get_count (MPI::INT)
-		     / (sizeof (SpatialNegotiationData) / sizeof (int)));
-	nextPos += nReceived;
+	recvDispls[i] = k * nIn;
+	nIn += recvCounts[i] / k;
+      }
+    NegotiationIntervals recvBuffer (std::max (nIn, 1));
+    c.Alltoallv (&sendBuffer[0], &sendCounts[0], &sendDispls[0], MPI::INT,
+		 &recvBuffer[0], &recvCounts[0], &recvDispls[0], MPI::INT);
+    for (unsigned int i = 0; i < n; ++i)
+      {
+	NegotiationIntervals::iterator first
+	  = recvBuffer.begin () + recvDispls[i] / k;
+	in[i].assign (first, first + recvCounts[i] / k);
       }
-    while (nReceived == TRANSMITTED_INTERVALS_MAX);
-    intervals.resize (nextPos);
-  }
-
-
-  void
-  SpatialNegotiator::allToAll (std::vector<NegotiationIntervals>& out,
-			       std::vector<NegotiationIntervals>& in)
-  {
-    if (out.size () != nProcesses || in.size () != nProcesses)
-      error ("internal error in SpatialNegotiator::allToAll ()");
-    in[localRank] = out[localRank];
-    for (unsigned int i = 0; i < localRank; ++i)
-      receive (comm, i, in[i]);
-    for (unsigned int i = localRank + 1; i < nProcesses; ++i)
-      send (comm, i, out[i]);
-    for (unsigned int i = 0; i < localRank; ++i)
-      send (comm, i, out[i]);
-    for (unsigned int i = localRank + 1; i < nProcesses; ++i)
-      receive (comm, i, in[i]);
   }
   
   
@@ -534,8 +675,9 @@ namespace MUSIC {
     results.resize (nProcesses);
 
     negotiateWidth (intercomm);
-    NegotiationIterator mappedDist = wrapIntervals (indices->begin (),
-						    indices->end (),
+    NegotiationIterator mappedDist = wrapIntervals (indices->data (),
+						    indices->data ()
+						    + indices->size (),
 						    type,
 						    localRank);
     NegotiationIterator canonicalDist
@@ -544,25 +686,24 @@ namespace MUSIC {
     intersectToBuffers (mappedDist, canonicalDist, results);
 
     // Send to virtual connector
-    allToAll (results, local);
+    allToAll (comm, results, local);
 
     // Receive from remote connector
-    for (int i = 0; i < remoteNProc; ++i)
-      receive (intercomm, i, remote[i]);
+    std::vector<NegotiationIntervals> none (remoteNProc);
+    allToAll (intercomm, none, remote);
     
     results.resize (remoteNProc);
     // core operation of virtual connector:
     intersectToBuffers (local, remote, results);
 
     // Send to remote connector
-    for (int i = 0; i < remoteNProc; ++i)
-      send (intercomm, i, results[i]);
+    allToAll (intercomm, results, none);
     
     results.resize (nProcesses);
     intersectToBuffers (remote, local, results);
 
     // Send back to real connector
-    allToAll (results, local);
+    allToAll (comm, results, local);
 
     return NegotiationIterator (local);
   }
@@ -596,8 +737,9 @@ namespace MUSIC {
     remote.resize (remoteNProc);
     
     negotiateWidth (intercomm);
-    NegotiationIterator mappedDist = wrapIntervals (indices->begin (),
-						    indices->end (),
+    NegotiationIterator mappedDist = wrapIntervals (indices->data (),
+						    indices->data ()
+						    + indices->size (),
 						    type,
 						    localRank);
     NegotiationIterator canonicalDist
@@ -605,11 +747,10 @@ namespace MUSIC {
 
     intersectToBuffers (mappedDist, canonicalDist, remote);
 
-    for (int i = 0; i < remoteNProc; ++i)
-      send (intercomm, i, remote[i]);
-    
-    for (int i = 0; i < remoteNProc; ++i)
-      receive (intercomm, i, remote[i]);
+    // Send to and receive from remote virtual connector
+    std::vector<NegotiationIntervals> none (remoteNProc);
+    allToAll (intercomm, remote, none);
+    allToAll (intercomm, none, remote);
     
     return NegotiationIterator (remote);
   }
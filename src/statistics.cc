@@ -0,0 +1,93 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "music/statistics.hh"
+
+#include <algorithm>
+#include <sstream>
+
+namespace MUSIC {
+
+  TransferCounters::TransferCounters ()
+    : messages (0),
+      bytes (0),
+      events (0),
+      communicationTime (0.0),
+      bufferHighWater (0)
+  {
+  }
+
+
+  void
+  TransferCounters::add (const TransferCounters& counters)
+  {
+    messages += counters.messages;
+    bytes += counters.bytes;
+    events += counters.events;
+    communicationTime += counters.communicationTime;
+    bufferHighWater = std::max (bufferHighWater, counters.bufferHighWater);
+  }
+
+
+  ConnectorStatistics::ConnectorStatistics ()
+    : output (false), subconnectors (0), copyTime (0.0)
+  {
+  }
+
+
+  Statistics::Statistics ()
+    : rank (0), ticks (0), tickTime (0.0)
+  {
+  }
+
+
+  // One line per connector, prefixed by the application and rank, so
+  // that the reports of all processes can be sorted together.
+  void
+  Statistics::report (std::ostream& out) const
+  {
+    std::ostringstream prefix;
+    prefix << "MUSIC statistics: " << applicationName
+	   << " rank " << rank << ": ";
+    std::ostringstream msg;
+    msg << prefix.str () << ticks << " ticks, "
+	<< tickTime << " s in tick" << std::endl;
+    for (std::vector<ConnectorStatistics>::const_iterator c
+	   = connectors.begin ();
+	 c != connectors.end ();
+	 ++c)
+      {
+	const TransferCounters& t = c->transfer;
+	msg << prefix.str ()
+	    << (c->output ? "output to " : "input at ")
+	    << c->receiverAppName << "." << c->receiverPortName
+	    << ": " << c->subconnectors << " peers, "
+	    << t.messages << (c->output ? " messages sent, " : " messages received, ")
+	    << t.bytes << " bytes, "
+	    << t.events << " events, "
+	    << t.communicationTime << " s communicating, "
+	    << c->copyTime << " s copying, "
+	    << "buffer high-water " << t.bufferHighWater << " bytes"
+	    << std::endl;
+      }
+    // write the report at once so that output from different
+    // processes is not interleaved within lines
+    out << msg.str () << std::flush;
+  }
+
+}
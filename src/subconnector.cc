@@ -22,6 +22,10 @@
 #include "music/communication.hh"
 
 #include "music/subconnector.hh"
+#include "music/error.hh"
+
+#include <algorithm>
+#include <cstring>
 
 #ifdef MUSIC_DEBUG
 #include <cstdlib>
@@ -43,6 +47,9 @@ namespace MUSIC {
       receiverPortCode_ (receiverPortCode)
   {
     flushed = false;
+    nonblocking_ = false;
+    persistent_ = false;
+    protocol_ = 0;
   }
 
 
@@ -50,18 +57,284 @@ namespace MUSIC {
   {
   }
 
+
+  TransferCounters
+  Subconnector::counters ()
+  {
+    TransferCounters counters = counters_;
+    counters.bufferHighWater = bufferHighWater ();
+    return counters;
+  }
+
+
+  PersistentRequests::Entry*
+  PersistentRequests::find (void* buf,
+			    int count,
+			    MPI::Datatype type,
+			    int tag)
+  {
+    for (Entry* e = entries_; e != entries_ + nEntries_; ++e)
+      if (e->buf == buf && e->count == count && e->type == type && e->tag == tag)
+	return e;
+    return NULL;
+  }
+
+
+  PersistentRequests::Entry&
+  PersistentRequests::replace (void* buf,
+			       int count,
+			       MPI::Datatype type,
+			       int tag)
+  {
+    Entry* replaced;
+    if (nEntries_ < MAX_REQUESTS)
+      replaced = &entries_[nEntries_++];
+    else
+      {
+	// The oldest request.  A subconnector has at most one send
+	// and one receive in flight, and completes them before
+	// starting the next ones, so this request is inactive.
+	replaced = &entries_[next_];
+	if (!replaced->request.Test ())
+	  error ("internal error: replacing an active persistent request");
+	replaced->request.Free ();
+	next_ = (next_ + 1) % MAX_REQUESTS;
+      }
+    Entry& e = *replaced;
+    e.buf = buf;
+    e.count = count;
+    e.type = type;
+    e.tag = tag;
+    return e;
+  }
+
+
+  MPI::Prequest&
+  PersistentRequests::send (MPI::Intercomm& comm,
+			    void* buf,
+			    int count,
+			    MPI::Datatype type,
+			    int dest,
+			    int tag)
+  {
+    Entry* e = find (buf, count, type, tag);
+    if (e == NULL)
+      {
+	e = &replace (buf, count, type, tag);
+	e->request = comm.Send_init (buf, count, type, dest, tag);
+      }
+    return e->request;
+  }
+
+
+  MPI::Prequest&
+  PersistentRequests::receive (MPI::Intercomm& comm,
+			       void* buf,
+			       int count,
+			       MPI::Datatype type,
+			       int source,
+			       int tag)
+  {
+    Entry* e = find (buf, count, type, tag);
+    if (e == NULL)
+      {
+	e = &replace (buf, count, type, tag);
+	e->request = comm.Recv_init (buf, count, type, source, tag);
+      }
+    return e->request;
+  }
+
+
+  void
+  PersistentRequests::free ()
+  {
+    for (Entry* e = entries_; e != entries_ + nEntries_; ++e)
+      e->request.Free ();
+    nEntries_ = 0;
+    next_ = 0;
+  }
+
+
+  // Send size bytes in chunks of at most maxSize bytes.  The last
+  // chunk is shorter than maxSize, possibly empty, which tells the
+  // receiver that the block is complete.  With the probe protocol,
+  // the block is instead sent as a single message.
+  void
+  OutputSubconnector::sendBlock (char* data,
+				 int size,
+				 MPI::Datatype type,
+				 int maxSize,
+				 int tag)
+  {
+    int typeSize = type.Get_size ();
+    if (protocol_ & PROTOCOL_PROBE)
+      {
+	sendChunk (data, size / typeSize, type, tag);
+	return;
+      }
+    while (size >= maxSize)
+      {
+	MUSIC_LOGR ("Sending " << maxSize << " bytes to rank " << remoteRank_);
+	sendChunk (data, maxSize / typeSize, type, tag);
+	data += maxSize;
+	size -= maxSize;
+      }
+    MUSIC_LOGR ("Last send " << size << " bytes to rank " << remoteRank_);
+    sendChunk (data, size / typeSize, type, tag);
+  }
+
+
+  void
+  OutputSubconnector::sendChunk (char* data,
+				 int count,
+				 MPI::Datatype type,
+				 int tag)
+  {
+    countMessage (count * type.Get_size ());
+    if (nonblocking_)
+      pendingSends_.push_back (intercomm.Isend (data,
+						count,
+						type,
+						remoteRank_,
+						tag));
+    else
+      intercomm.Send (data, count, type, remoteRank_, tag);
+  }
+
+
+  // Send a single message through a persistent request
+  void
+  OutputSubconnector::sendPersistent (void* data,
+				      int count,
+				      MPI::Datatype type,
+				      int tag)
+  {
+    countMessage (count * type.Get_size ());
+    MPI::Prequest& request = requests_.send (intercomm,
+					     data,
+					     count,
+					     type,
+					     remoteRank_,
+					     tag);
+    request.Start ();
+    if (nonblocking_)
+      pendingSends_.push_back (request);
+    else
+      request.Wait ();
+  }
+
+
+  // In non-blocking mode, the data of the previous communication must
+  // not be touched until its sends have completed.  We complete them
+  // lazily at the next communication, or when flushing.
+  void
+  OutputSubconnector::completeSends ()
+  {
+    if (!pendingSends_.empty ())
+      {
+	MPI::Request::Waitall (pendingSends_.size (), &pendingSends_[0]);
+	pendingSends_.clear ();
+      }
+  }
+
   
   BufferingOutputSubconnector::BufferingOutputSubconnector (int elementSize)
     : buffer_ (elementSize)
   {
   }
 
+
+  void
+  BufferingOutputSubconnector::nextBlock (void*& data, int& size)
+  {
+    if (nonblocking_)
+      {
+	completeSends ();
+	buffer_.swapBlock (data, size);
+      }
+    else
+      buffer_.nextBlock (data, size);
+  }
+
+
+  void
+  BufferingOutputSubconnector::nextNeighborBlock (void*& data, int& size)
+  {
+    buffer_.nextBlock (data, size);
+  }
+
   
   InputSubconnector::InputSubconnector ()
   {
   }
 
 
+  std::vector<char> InputSubconnector::scratch_;
+
+
+  // Shared receive buffer of at least size bytes.  Its content is
+  // only valid until the next receive by any input subconnector.
+  void*
+  InputSubconnector::scratch (int size)
+  {
+    if (scratch_.size () < (size_t) size || scratch_.empty ())
+      scratch_.resize (std::max (size, 1));
+    return static_cast<void*> (&scratch_[0]);
+  }
+
+
+  // Size in bytes of the next incoming message.  A flush message is
+  // consumed here, in which case we return 0.
+  int
+  InputSubconnector::probeMessage (int tag)
+  {
+    MPI::Status status;
+    intercomm.Probe (remoteRank_, tag, status);
+    if (status.Get_tag () == FLUSH_MSG)
+      {
+	char dummy;
+	intercomm.Recv (&dummy, 0, MPI::BYTE, remoteRank_, FLUSH_MSG);
+	flushed = true;
+	return 0;
+      }
+    return status.Get_count (MPI::BYTE);
+  }
+
+
+  // Receives can only be posted in advance if their size is bounded
+  bool
+  InputSubconnector::preposting ()
+  {
+    return nonblocking_ && !flushed && !(protocol_ & PROTOCOL_PROBE);
+  }
+
+
+  // Complete the receive pre-posted at the previous communication.
+  // Returns false if there is none.
+  bool
+  InputSubconnector::completeReceive (MPI::Status& status)
+  {
+    if (pendingReceive_ == MPI::REQUEST_NULL)
+      return false;
+    pendingReceive_.Wait (status);
+    // a persistent request stays allocated
+    pendingReceive_ = MPI::REQUEST_NULL;
+    return true;
+  }
+
+
+  void
+  InputSubconnector::postReceive (int maxSize, int tag)
+  {
+    receiveBuffer_.resize (maxSize);
+    pendingReceive_ = intercomm.Irecv (&receiveBuffer_[0],
+				       maxSize,
+				       MPI::BYTE,
+				       remoteRank_,
+				       tag);
+  }
+
+
   /********************************************************************
    *
    * Cont Subconnectors
@@ -81,8 +354,25 @@ namespace MUSIC {
 		    remoteRank,
 		    receiverPortCode_),
       BufferingOutputSubconnector (0),
-      ContSubconnector (type)
+      ContSubconnector (type),
+      plan_ (NULL),
+      sendDirect_ (false)
+  {
+  }
+
+
+  // With direct sends, a sample is sent straight from the application
+  // array when it is the only data to send.  This needs blocking
+  // communication, since the application may modify the data after
+  // the tick, and that the data fits in a single message.
+  void
+  ContOutputSubconnector::setDirect (Distributor::Plan* plan)
   {
+    plan_ = plan;
+    sendDirect_ = (!nonblocking_
+		   && plan->copy.size () > 0
+		   && ((protocol_ & PROTOCOL_PROBE)
+		       || plan->copy.size () < CONT_BUFFER_MAX));
   }
   
 
@@ -104,28 +394,45 @@ namespace MUSIC {
   void
   ContOutputSubconnector::send ()
   {
+    if (plan_ != NULL)
+      {
+	if (sendDirect_ && plan_->pending && buffer_.isEmpty ())
+	  {
+	    if (persistent_)
+	      sendPersistent (plan_->base, 1, plan_->type, CONT_MSG);
+	    else
+	      {
+		countMessage (plan_->type.Get_size ());
+		intercomm.Send (plan_->base, 1, plan_->type, remoteRank_, CONT_MSG);
+	      }
+	    plan_->pending = false;
+	    return;
+	  }
+	plan_->store ();
+      }
     void* data;
     int size;
-    buffer_.nextBlock (data, size);
-    // NOTE: marshalling
-    char* buffer = static_cast <char*> (data);
-    while (size >= CONT_BUFFER_MAX)
+    nextBlock (data, size);
+    // Blocks which fit in a single message are sent with a
+    // persistent request.  The send buffer rarely moves, and the
+    // block size is the same at most communications.
+    if (persistent_
+	&& ((protocol_ & PROTOCOL_PROBE) || size < CONT_BUFFER_MAX))
       {
-	MUSIC_LOGR ("Sending " << CONT_BUFFER_MAX << " bytes to rank " << remoteRank_);
-	intercomm.Send (buffer,
-			CONT_BUFFER_MAX / type_.Get_size (),
-			type_,
-			remoteRank_,
-			CONT_MSG);
-	buffer += CONT_BUFFER_MAX;
-	size -= CONT_BUFFER_MAX;
+	sendPersistent (data, size / type_.Get_size (), type_, CONT_MSG);
+	return;
       }
-    MUSIC_LOGR ("Last send " << size << " bytes to rank " << remoteRank_);
-    intercomm.Send (buffer,
-		    size / type_.Get_size (),
-		    type_,
-		    remoteRank_,
-		    CONT_MSG);
+    // NOTE: marshalling
+    sendBlock (static_cast <char*> (data), size, type_, CONT_BUFFER_MAX, CONT_MSG);
+  }
+
+
+  void
+  ContOutputSubconnector::nextNeighborBlock (void*& data, int& size)
+  {
+    if (plan_ != NULL)
+      plan_->store ();
+    BufferingOutputSubconnector::nextNeighborBlock (data, size);
   }
 
   
@@ -142,6 +449,7 @@ namespace MUSIC {
 	  }
 	else
 	  {
+	    completeSends ();
 	    char dummy;
 	    intercomm.Send (&dummy, 0, type_, remoteRank_, FLUSH_MSG);
 	    flushed = true;
@@ -174,6 +482,8 @@ namespace MUSIC {
   {
     receive ();
     buffer_.fill (synch->initialBufferedTicks ());
+    if (preposting ())
+      postBlockReceive ();
   }
   
 
@@ -181,7 +491,11 @@ namespace MUSIC {
   ContInputSubconnector::maybeCommunicate ()
   {
     if (!flushed && synch->communicate ())
-      receive ();    
+      {
+	receive ();
+	if (preposting ())
+	  postBlockReceive ();
+      }
   }
 
 
@@ -191,16 +505,53 @@ namespace MUSIC {
     char* data;
     MPI::Status status;
     int size;
-    do
+    if (protocol_ & PROTOCOL_PROBE)
       {
+	size = probeMessage (MPI::ANY_TAG);
+	if (flushed)
+	  {
+	    MUSIC_LOGR ("received flush message");
+	    return;
+	  }
+	// No persistent request here: the BIFO block moves at each
+	// receive, and since the size is only known after probing, the
+	// receive can't be started early anyway.
 	data = static_cast<char*> (buffer_.insertBlock ());
-	MUSIC_LOGR ("Receiving from rank " << remoteRank_);
 	intercomm.Recv (data,
-			CONT_BUFFER_MAX / type_.Get_size (),
+			size / type_.Get_size (),
 			type_,
 			remoteRank_,
-			MPI::ANY_TAG,
-			status);
+			CONT_MSG);
+	countMessage (size);
+	buffer_.trimBlock (size);
+	return;
+      }
+    do
+      {
+	if (!completeReceive (status))
+	  {
+	    data = static_cast<char*> (buffer_.insertBlock ());
+	    MUSIC_LOGR ("Receiving from rank " << remoteRank_);
+	    if (persistent_)
+	      {
+		MPI::Prequest& request
+		  = requests_.receive (intercomm,
+				       data,
+				       CONT_BUFFER_MAX / type_.Get_size (),
+				       type_,
+				       remoteRank_,
+				       MPI::ANY_TAG);
+		request.Start ();
+		request.Wait (status);
+	      }
+	    else
+	      intercomm.Recv (data,
+			      CONT_BUFFER_MAX / type_.Get_size (),
+			      type_,
+			      remoteRank_,
+			      MPI::ANY_TAG,
+			      status);
+	  }
 	if (status.Get_tag () == FLUSH_MSG)
 	  {
 	    flushed = true;
@@ -208,12 +559,61 @@ namespace MUSIC {
 	    return;
 	  }
 	size = status.Get_count (MPI::BYTE);
+	countMessage (size);
 	buffer_.trimBlock (size);
       }
     while (size == CONT_BUFFER_MAX);
   }
 
 
+  // The BIFO block stays out of reach of the reader until trimBlock
+  // so we can let MPI fill it in the background.
+  void
+  ContInputSubconnector::postBlockReceive ()
+  {
+    char* data = static_cast<char*> (buffer_.insertBlock ());
+    if (persistent_)
+      {
+	MPI::Prequest& request
+	  = requests_.receive (intercomm,
+			       data,
+			       CONT_BUFFER_MAX / type_.Get_size (),
+			       type_,
+			       remoteRank_,
+			       MPI::ANY_TAG);
+	request.Start ();
+	pendingReceive_ = request;
+	return;
+      }
+    pendingReceive_ = intercomm.Irecv (data,
+				       CONT_BUFFER_MAX / type_.Get_size (),
+				       type_,
+				       remoteRank_,
+				       MPI::ANY_TAG);
+  }
+
+
+  void*
+  ContInputSubconnector::reserveNeighborBlock (int)
+  {
+    return buffer_.insertBlock ();
+  }
+
+
+  void
+  ContInputSubconnector::deliverNeighborBlock (void*, int size)
+  {
+    buffer_.trimBlock (size);
+  }
+
+
+  void
+  ContInputSubconnector::initialNeighborDelivery ()
+  {
+    buffer_.fill (synch->initialBufferedTicks ());
+  }
+
+
   void
   ContInputSubconnector::flush (bool& dataStillFlowing)
   {
@@ -268,20 +668,139 @@ namespace MUSIC {
     MUSIC_LOGRE ("send");
     void* data;
     int size;
-    buffer_.nextBlock (data, size);
+    nextBlock (data, size);
+    countEvents (size / sizeof (Event));
+    if (protocol_ & PROTOCOL_COMPACT)
+      {
+	sendCompact (static_cast<Event*> (data), size / sizeof (Event));
+	return;
+      }
     // NOTE: marshalling
-    char* buffer = static_cast <char*> (data);
-    while (size >= SPIKE_BUFFER_MAX)
+    sendBlock (static_cast <char*> (data),
+	       size,
+	       MPI::BYTE,
+	       SPIKE_BUFFER_MAX,
+	       SPIKE_MSG);
+  }
+
+
+  void
+  EventOutputSubconnector::nextNeighborBlock (void*& data, int& size)
+  {
+    BufferingOutputSubconnector::nextNeighborBlock (data, size);
+    countEvents (size / sizeof (Event));
+  }
+
+
+  static bool
+  lessEventId (const Event& e1, const Event& e2)
+  {
+    return e1.id < e2.id;
+  }
+
+
+  // Send events in the compact wire format.  The events are sorted
+  // on index, which is the order in which they are delivered, also
+  // when sent unencoded.  Unless the probe
+  // protocol is used, the events are split over messages which fit
+  // in SPIKE_BUFFER_MAX bytes.  Time offsets are rounded to the
+  // timebase of the sender.  If they do not fit in 32 bits, the
+  // events are sent unencoded, which is decided before splitting
+  // since unencoded events take more room.
+  void
+  EventOutputSubconnector::sendCompact (Event* ev, int nEvents)
+  {
+    std::stable_sort (ev, ev + nEvents, lessEventId);
+    bool raw = false;
+    if (nEvents > 0)
       {
-	intercomm.Send (buffer,
-			SPIKE_BUFFER_MAX,
-			MPI::BYTE,
-			remoteRank_,
-			SPIKE_MSG);
-	buffer += SPIKE_BUFFER_MAX;
-	size -= SPIKE_BUFFER_MAX;
+	double first = ev[0].t;
+	double last = ev[0].t;
+	for (int i = 1; i < nEvents; ++i)
+	  {
+	    first = std::min (first, ev[i].t);
+	    last = std::max (last, ev[i].t);
+	  }
+	raw = (last - first) / synch->timebase () >= 4294967295.0;
+      }
+    int maxEvents = nEvents;
+    if (!(protocol_ & PROTOCOL_PROBE))
+      {
+	// a time offset and at most five bytes of id per event
+	int eventSize = raw ? sizeof (Event) : 9;
+	maxEvents = (SPIKE_BUFFER_MAX - sizeof (CompactHeader)) / eventSize;
+      }
+    encoded_.clear ();
+    messages_.clear ();
+    int i = 0;
+    do
+      {
+	int n = std::min (nEvents - i, maxEvents);
+	messages_.push_back (encoded_.size ());
+	encode (ev + i, n, i + n < nEvents, raw);
+	i += n;
+      }
+    while (i < nEvents);
+    messages_.push_back (encoded_.size ());
+    for (unsigned int m = 0; m + 1 < messages_.size (); ++m)
+      sendChunk (&encoded_[messages_[m]],
+		 messages_[m + 1] - messages_[m],
+		 MPI::BYTE,
+		 SPIKE_MSG);
+  }
+
+
+  // Append one message to encoded_, with the events unencoded if
+  // raw is true
+  void
+  EventOutputSubconnector::encode (Event* ev, int nEvents, bool more, bool raw)
+  {
+    CompactHeader header;
+    header.base = 0.0;
+    header.resolution = synch->timebase ();
+    header.nEvents = nEvents;
+    header.flags = more ? COMPACT_MORE : 0;
+    if (raw)
+      header.flags |= COMPACT_RAW;
+    if (nEvents > 0)
+      {
+	header.base = ev[0].t;
+	for (int i = 1; i < nEvents; ++i)
+	  header.base = std::min (header.base, ev[i].t);
       }
-    intercomm.Send (buffer, size, MPI::BYTE, remoteRank_, SPIKE_MSG);
+    
+    int pos = encoded_.size ();
+    encoded_.resize (pos + sizeof (CompactHeader) + nEvents * sizeof (Event));
+    char* data = &encoded_[pos];
+    memcpy (data, &header, sizeof (CompactHeader));
+    data += sizeof (CompactHeader);
+    if (header.flags & COMPACT_RAW)
+      {
+	memcpy (data, ev, nEvents * sizeof (Event));
+	return;
+      }
+    
+    for (int i = 0; i < nEvents; ++i)
+      {
+	unsigned int offset = static_cast<unsigned int>
+	  ((ev[i].t - header.base) / header.resolution + 0.5);
+	memcpy (data, &offset, sizeof (offset));
+	data += sizeof (offset);
+      }
+    // ids are sorted, so differences are non-negative
+    unsigned int previous = 0;
+    for (int i = 0; i < nEvents; ++i)
+      {
+	unsigned int delta = static_cast<unsigned int> (ev[i].id) - previous;
+	previous = ev[i].id;
+	while (delta >= 0x80)
+	  {
+	    *data++ = static_cast<char> (delta | 0x80);
+	    delta >>= 7;
+	  }
+	*data++ = static_cast<char> (delta);
+      }
+    encoded_.resize (data - &encoded_[0]);
   }
 
   
@@ -296,11 +815,27 @@ namespace MUSIC {
 	    send ();
 	    dataStillFlowing = true;
 	  }
+	else if (protocol_ & PROTOCOL_COMPACT)
+	  {
+	    completeSends ();
+	    CompactHeader header;
+	    header.base = 0.0;
+	    header.resolution = 0.0;
+	    header.nEvents = FLUSH_MARK;
+	    header.flags = 0;
+	    encoded_.resize (sizeof (CompactHeader));
+	    memcpy (&encoded_[0], &header, sizeof (CompactHeader));
+	    sendChunk (&encoded_[0], encoded_.size (), MPI::BYTE, SPIKE_MSG);
+	    completeSends ();
+	    flushed = true;
+	  }
 	else
 	  {
 	    Event* e = static_cast<Event*> (buffer_.insert ());
 	    e->id = FLUSH_MARK;
 	    send ();
+	    countEvents (-1);	// the flush mark is not an event
+	    completeSends ();
 	    flushed = true;
 	  }
       }
@@ -382,31 +917,56 @@ namespace MUSIC {
   EventInputSubconnectorLocal::dummyHandler;
 
   
+  void
+  EventInputSubconnector::initialCommunication ()
+  {
+    if (preposting ())
+      postReceive (SPIKE_BUFFER_MAX, SPIKE_MSG);
+  }
+
+  
   void
   EventInputSubconnector::maybeCommunicate ()
   {
     if (!flushed && synch->communicate ())
-      receive ();    
+      {
+	receive ();
+	if (preposting ())
+	  postReceive (SPIKE_BUFFER_MAX, SPIKE_MSG);
+      }
   }
 
 
-  // NOTE: isolate difference between global and local to avoid code repetition
   void
-  EventInputSubconnectorGlobal::receive ()
+  EventInputSubconnector::receive ()
   {
-    char data[SPIKE_BUFFER_MAX]; 
+    if (protocol_ & PROTOCOL_COMPACT)
+      {
+	receiveCompact ();
+	return;
+      }
     MPI::Status status;
     int size;
     do
       {
-	intercomm.Recv (data,
-			SPIKE_BUFFER_MAX,
-			MPI::BYTE,
-			remoteRank_,
-			SPIKE_MSG,
-			status);
-	Event* ev = (Event*) data;
+	Event* ev;
+	if (completeReceive (status))
+	  ev = (Event*) &receiveBuffer_[0];
+	else
+	  {
+	    int maxSize = SPIKE_BUFFER_MAX;
+	    if (protocol_ & PROTOCOL_PROBE)
+	      maxSize = probeMessage (SPIKE_MSG);
+	    ev = reserve (maxSize);
+	    intercomm.Recv (ev,
+			    maxSize,
+			    MPI::BYTE,
+			    remoteRank_,
+			    SPIKE_MSG,
+			    status);
+	  }
 	size = status.Get_count (MPI::BYTE);
+	countMessage (size);
 	if (size > 0 && ev[0].id == FLUSH_MARK)
 	  {
 	    flushed = true;
@@ -415,40 +975,152 @@ namespace MUSIC {
 	  }
 	int nEvents = size / sizeof (Event);
 	//MUSIC_LOGR ("received " << nEvents << "events");
-	for (int i = 0; i < nEvents; ++i)
-	  (*handleEvent) (ev[i].t, ev[i].id);
+	countEvents (nEvents);
+	deliver (ev, nEvents);
       }
-    while (size == SPIKE_BUFFER_MAX);
+    while (size == SPIKE_BUFFER_MAX && !(protocol_ & PROTOCOL_PROBE));
   }
 
 
   void
-  EventInputSubconnectorLocal::receive ()
+  EventInputSubconnector::receiveCompact ()
   {
-    MUSIC_LOGRE ("receive");
-    char data[SPIKE_BUFFER_MAX]; 
     MPI::Status status;
-    int size;
+    CompactHeader header;
     do
       {
-	intercomm.Recv (data,
-			SPIKE_BUFFER_MAX,
-			MPI::BYTE,
-			remoteRank_,
-			SPIKE_MSG,
-			status);
-	Event* ev = (Event*) data;
-	size = status.Get_count (MPI::BYTE);
-	if (size > 0 && ev[0].id == FLUSH_MARK)
+	if (!completeReceive (status))
+	  {
+	    int maxSize = SPIKE_BUFFER_MAX;
+	    if (protocol_ & PROTOCOL_PROBE)
+	      maxSize = probeMessage (SPIKE_MSG);
+	    if (receiveBuffer_.size () < (size_t) maxSize)
+	      receiveBuffer_.resize (maxSize);
+	    intercomm.Recv (&receiveBuffer_[0],
+			    maxSize,
+			    MPI::BYTE,
+			    remoteRank_,
+			    SPIKE_MSG,
+			    status);
+	  }
+	countMessage (status.Get_count (MPI::BYTE));
+	const char* data = &receiveBuffer_[0];
+	memcpy (&header, data, sizeof (CompactHeader));
+	data += sizeof (CompactHeader);
+	if (header.nEvents == FLUSH_MARK)
 	  {
 	    flushed = true;
 	    return;
 	  }
-	int nEvents = size / sizeof (Event);
-	for (int i = 0; i < nEvents; ++i)
-	  (*handleEvent) (ev[i].t, ev[i].id);
+	
+	int nEvents = header.nEvents;
+	countEvents (nEvents);
+	Event* ev = reserve (nEvents * sizeof (Event));
+	if (header.flags & COMPACT_RAW)
+	  memcpy (ev, data, nEvents * sizeof (Event));
+	else
+	  {
+	    const char* ids = data + nEvents * sizeof (unsigned int);
+	    unsigned int id = 0;
+	    for (int i = 0; i < nEvents; ++i)
+	      {
+		unsigned int offset;
+		memcpy (&offset, data, sizeof (offset));
+		data += sizeof (offset);
+		unsigned int delta = 0;
+		int shift = 0;
+		unsigned char byte;
+		do
+		  {
+		    byte = *ids++;
+		    delta |= (byte & 0x7f) << shift;
+		    shift += 7;
+		  }
+		while (byte & 0x80);
+		id += delta;
+		ev[i].t = header.base + offset * header.resolution;
+		ev[i].id = id;
+	      }
+	  }
+	deliver (ev, nEvents);
       }
-    while (size == SPIKE_BUFFER_MAX);
+    while (header.flags & COMPACT_MORE);
+  }
+
+
+  Event*
+  EventInputSubconnector::reserve (int size)
+  {
+    return static_cast<Event*> (scratch (size));
+  }
+
+
+  void
+  EventInputSubconnector::deliverNeighborBlock (void* data, int size)
+  {
+    countEvents (size / sizeof (Event));
+    deliver (static_cast<Event*> (data), size / sizeof (Event));
+  }
+
+
+  void
+  EventInputSubconnectorGlobal::deliver (Event* ev, int nEvents)
+  {
+    handleEvent->handleEvents (ev, nEvents);
+  }
+
+
+  void
+  EventInputSubconnectorLocal::deliver (Event* ev, int nEvents)
+  {
+    handleEvent->handleEvents (ev, nEvents);
+  }
+
+
+  EventInputSubconnectorBuffer::EventInputSubconnectorBuffer
+  (Synchronizer* synch_,
+   MPI::Intercomm intercomm,
+   int remoteLeader,
+   int remoteRank,
+   int receiverRank,
+   int receiverPortCode,
+   FIBO* events)
+    : Subconnector (synch_,
+		    intercomm,
+		    remoteLeader,
+		    remoteRank,
+		    receiverRank,
+		    receiverPortCode),
+      EventInputSubconnector (synch_,
+			      intercomm,
+			      remoteLeader,
+			      remoteRank,
+			      receiverRank,
+			      receiverPortCode),
+      events_ (events),
+      reserved_ (NULL)
+  {
+  }
+
+
+  // Blocking receives go straight into the port buffer.  Data from
+  // a pre-posted receive has to be copied since the port buffer is
+  // cleared at each tick.
+  Event*
+  EventInputSubconnectorBuffer::reserve (int size)
+  {
+    reserved_ = static_cast<Event*> (events_->insertBlock (size));
+    return reserved_;
+  }
+
+
+  void
+  EventInputSubconnectorBuffer::deliver (Event* ev, int nEvents)
+  {
+    if (ev == reserved_)
+      events_->trimBlock (nEvents * sizeof (Event));
+    else
+      events_->insert (ev, nEvents);
   }
 
 
@@ -479,6 +1151,14 @@ namespace MUSIC {
     handleEvent = &dummyHandler;
     EventInputSubconnector::flush (dataStillFlowing);
   }
+
+
+  void
+  EventInputSubconnectorBuffer::flush (bool& dataStillFlowing)
+  {
+    events_->clear ();
+    EventInputSubconnector::flush (dataStillFlowing);
+  }
   
   /********************************************************************
    *
@@ -491,15 +1171,23 @@ namespace MUSIC {
 							int remoteLeader,
 							int remoteRank,
 							int receiverPortCode,
-							FIBO* buffer)
+							MessageLog* log)
     : Subconnector (synch_,
 		    intercomm,
 		    remoteLeader,
 		    remoteRank,
 		    remoteRank,
 		    receiverPortCode),
-      buffer_ (buffer)
+      log_ (log),
+      reader_ (log->addReader ())
+  {
+    log_->addReference ();
+  }
+
+
+  MessageOutputSubconnector::~MessageOutputSubconnector ()
   {
+    log_->removeReference ();
   }
   
 
@@ -516,20 +1204,26 @@ namespace MUSIC {
   {
     void* data;
     int size;
-    buffer_->nextBlockNoClear (data, size);
-    // NOTE: marshalling
-    char* buffer = static_cast <char*> (data);
-    while (size >= MESSAGE_BUFFER_MAX)
+    log_->unread (reader_, data, size);
+    if (nonblocking_)
       {
-	intercomm.Send (buffer,
-			MESSAGE_BUFFER_MAX,
-			MPI::BYTE,
-			remoteRank_,
-			MESSAGE_MSG);
-	buffer += MESSAGE_BUFFER_MAX;
-	size -= MESSAGE_BUFFER_MAX;
+	// The log may be compacted or reused after this tick, so keep
+	// a copy until the sends have completed.
+	completeSends ();
+	if (size > 0)
+	  {
+	    char* block = static_cast<char*> (data);
+	    sendBuffer_.assign (block, block + size);
+	    data = &sendBuffer_[0];
+	  }
       }
-    intercomm.Send (buffer, size, MPI::BYTE, remoteRank_, MESSAGE_MSG);
+    // NOTE: marshalling
+    sendBlock (static_cast <char*> (data),
+	       size,
+	       MPI::BYTE,
+	       MESSAGE_BUFFER_MAX,
+	       MESSAGE_MSG);
+    log_->markRead (reader_);
   }
 
   
@@ -538,7 +1232,7 @@ namespace MUSIC {
   {
     if (!flushed)
       {
-	if (!buffer_->isEmpty ())
+	if (!log_->isRead (reader_))
 	  {
 	    MUSIC_LOGRE ("sending data remaining in buffers");
 	    send ();
@@ -546,6 +1240,7 @@ namespace MUSIC {
 	  }
 	else
 	  {
+	    completeSends ();
 	    char dummy;
 	    intercomm.Send (&dummy, 0, MPI::BYTE, remoteRank_, FLUSH_MSG);	
 	    flushed = true;
@@ -576,28 +1271,60 @@ namespace MUSIC {
   MessageInputSubconnector::dummyHandler;
 
   
+  void
+  MessageInputSubconnector::initialCommunication ()
+  {
+    if (preposting ())
+      postReceive (MESSAGE_BUFFER_MAX, MPI::ANY_TAG);
+  }
+
+  
   void
   MessageInputSubconnector::maybeCommunicate ()
   {
     if (!flushed && synch->communicate ())
-      receive ();    
+      {
+	receive ();
+	if (preposting ())
+	  postReceive (MESSAGE_BUFFER_MAX, MPI::ANY_TAG);
+      }
   }
 
 
   void
   MessageInputSubconnector::receive ()
   {
-    char data[MESSAGE_BUFFER_MAX]; 
+    char buffer[MESSAGE_BUFFER_MAX]; 
     MPI::Status status;
     int size;
     do
       {
-	intercomm.Recv (data,
-			MESSAGE_BUFFER_MAX,
-			MPI::BYTE,
-			remoteRank_,
-			MPI::ANY_TAG,
-			status);
+	char* data = buffer;
+	if (completeReceive (status))
+	  data = &receiveBuffer_[0];
+	else if (protocol_ & PROTOCOL_PROBE)
+	  {
+	    size = probeMessage (MPI::ANY_TAG);
+	    if (flushed)
+	      {
+		MUSIC_LOGRE ("received flush message");
+		return;
+	      }
+	    data = static_cast<char*> (scratch (size));
+	    intercomm.Recv (data,
+			    size,
+			    MPI::BYTE,
+			    remoteRank_,
+			    MESSAGE_MSG,
+			    status);
+	  }
+	else
+	  intercomm.Recv (data,
+			  MESSAGE_BUFFER_MAX,
+			  MPI::BYTE,
+			  remoteRank_,
+			  MPI::ANY_TAG,
+			  status);
 	if (status.Get_tag () == FLUSH_MSG)
 	  {
 	    flushed = true;
@@ -605,6 +1332,7 @@ namespace MUSIC {
 	    return;
 	  }
 	size = status.Get_count (MPI::BYTE);
+	countMessage (size);
 	int current = 0;
 	while (current < size)
 	  {
@@ -615,7 +1343,7 @@ namespace MUSIC {
 	    current += header->size ();
 	  }
       }
-    while (size == MESSAGE_BUFFER_MAX);
+    while (size == MESSAGE_BUFFER_MAX && !(protocol_ & PROTOCOL_PROBE));
   }
 
 
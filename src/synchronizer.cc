@@ -34,31 +34,76 @@ namespace MUSIC {
   // realized by the clocks nextSend and nextReceive
   void
   Synchronizer::nextCommunication ()
+  {
+#ifdef MUSIC_DEBUG
+    Clock send = nextSend;
+    Clock receive = nextReceive;
+    nextCommunicationByTicks (send, receive);
+#endif
+    nextCommunication (nextSend, nextReceive);
+#ifdef MUSIC_DEBUG
+    if (!(send == nextSend) || !(receive == nextReceive))
+      {
+	MUSIC_LOGRE ("nextCommunication: closed form gives send "
+		     << nextSend.integerTime () << ", receive "
+		     << nextReceive.integerTime () << " but ticking gives send "
+		     << send.integerTime () << ", receive "
+		     << receive.integerTime ());
+	abort ();
+      }
+#endif
+    MUSIC_LOGRE ("next send at " << nextSend.time ()
+		 << ", next receive at " << nextReceive.time ());
+  }
+
+
+  // Advances the clocks as nextCommunicationByTicks below but
+  // computes the number of ticks in each loop directly.
+  void
+  Synchronizer::nextCommunication (Clock& send, Clock& receive)
+  {
+    ClockState limit
+      = send.integerTime () + latency_ - receive.tickInterval ();
+    if (receive.integerTime () <= limit)
+      receive.ticks ((limit - receive.integerTime ())
+		     / receive.tickInterval () + 1);
+    limit = receive.integerTime () + receive.tickInterval () - latency_;
+    int bCount = 0;
+    if (send.integerTime () <= limit)
+      {
+	bCount = (limit - send.integerTime ()) / send.tickInterval () + 1;
+	send.ticks (bCount);
+      }
+    if (bCount < maxBuffered_)
+      send.ticks (maxBuffered_ - bCount);
+  }
+
+
+  // The original formulation of the algorithm, kept as a reference
+  void
+  Synchronizer::nextCommunicationByTicks (Clock& send, Clock& receive)
   {
     // Advance receive time as much as possible
     // still ensuring that oldest data arrives in time
     ClockState limit
-      = nextSend.integerTime () + latency_ - nextReceive.tickInterval ();
-    while (nextReceive.integerTime () <= limit)
-      nextReceive.tick ();
+      = send.integerTime () + latency_ - receive.tickInterval ();
+    while (receive.integerTime () <= limit)
+      receive.tick ();
     // Advance send time to match receive time
-    limit = nextReceive.integerTime () + nextReceive.tickInterval () - latency_;
+    limit = receive.integerTime () + receive.tickInterval () - latency_;
     int bCount = 0;
-    while (nextSend.integerTime () <= limit)
+    while (send.integerTime () <= limit)
       {
-	nextSend.tick ();
+	send.tick ();
 	++bCount;
       }
     // Advance send time according to precalculated buffer
     if (bCount < maxBuffered_)
-      nextSend.ticks (maxBuffered_ - bCount);
+      send.ticks (maxBuffered_ - bCount);
 #if 0 //*fixme* Need to handle this the correct way
     else if (maxBuffered_ == 0)
-      nextSend.ticks (-1);	// arises with tight loops of spike events
+      send.ticks (-1);	// arises with tight loops of spike events
 #endif
-    MUSIC_LOGRE ("next send at " << nextSend.time ()
-		 << ", next receive at " << nextReceive.time ()
-		 << ", bCount = " << bCount);
   }
 
   // The following set of mutators are used by the TemporalNegotiator
@@ -150,6 +195,21 @@ namespace MUSIC {
   }
 
 
+  // Ticks before nextSend have no effect.  After a communication,
+  // the schedule is advanced at the following tick, which we
+  // anticipate here.
+  ClockState
+  OutputSynchronizer::nextCommunicationTime ()
+  {
+    if (!communicate_)
+      return nextSend.integerTime ();
+    Clock send = nextSend;
+    Clock receive = nextReceive;
+    nextCommunication (send, receive);
+    return send.integerTime ();
+  }
+
+
   // Return the number of copies of the data sampled by the sender
   // Runtime constructor which should be stored in the receiver
   // buffers at the first tick () (which occurs at the end of the
@@ -204,6 +264,18 @@ namespace MUSIC {
   }
 
 
+  ClockState
+  InputSynchronizer::nextCommunicationTime ()
+  {
+    if (!communicate_)
+      return nextReceive.integerTime ();
+    Clock send = nextSend;
+    Clock receive = nextReceive;
+    nextCommunication (send, receive);
+    return receive.integerTime ();
+  }
+
+
   // This function is only called when sender is remote
   void
   InterpolationSynchronizer::setSenderTickInterval (ClockState ti)
@@ -0,0 +1,215 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Leave as first include---required by BG/L
+#include <mpi.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+extern "C" {
+#include <unistd.h>
+#include <getopt.h>
+}
+
+#include <music.hh>
+
+// `eventlag' checks that events arrive in time when event and
+// continuous connections with different communication schedules are
+// mixed.  With the output port "out" connected, one event per index
+// and tick is sent.  The optional cont input port "contdata" is read
+// with a small buffer, so that its connector communicates more often
+// than the event connector.  With the input port "in" connected, the
+// lag of each event, the time between the event time and the tick
+// where it is delivered, is checked against the acceptable latency.
+
+const double DEFAULT_TIMESTEP = 1e-3;
+const double DEFAULT_LATENCY = 1e-2;
+
+void
+usage (int rank)
+{
+  if (rank == 0)
+    {
+      std::cerr << "Usage: eventlag [OPTION...]" << std::endl
+		<< "`eventlag' sends or receives events and checks their lag" << std::endl << std:: endl
+		<< "  -t, --timestep TIMESTEP time between tick() calls (default " << DEFAULT_TIMESTEP << " s)" << std::endl
+		<< "  -l, --latency SECS      acceptable latency (default " << DEFAULT_LATENCY << " s)" << std::endl
+		<< "  -b, --maxbuffer TICKS   maximal event buffer (default 100)" << std::endl
+		<< "  -c, --contbuffer TICKS  maximal cont buffer (default 5)" << std::endl
+		<< "  -h, --help              print this help message" << std::endl << std::endl
+		<< "Report bugs to <music-bugs@incf.org>." << std::endl;
+    }
+  exit (1);
+}
+
+double timestep = DEFAULT_TIMESTEP;
+double latency = DEFAULT_LATENCY;
+int maxbuffered = 100;
+int contbuffered = 5;
+
+MUSIC::Runtime* runtime;
+int nReceived = 0;
+double maxLag = 0.0;
+
+class LagHandler: public MUSIC::EventHandlerGlobalIndex {
+public:
+  void operator () (double t, MUSIC::GlobalIndex /* id */)
+  {
+    ++nReceived;
+    maxLag = std::max (maxLag, runtime->time () - t);
+  }
+};
+
+
+void
+getargs (int rank, int argc, char* argv[])
+{
+  opterr = 0; // handle errors ourselves
+  while (1)
+    {
+      static struct option longOptions[] =
+	{
+	  {"timestep",   required_argument, 0, 't'},
+	  {"latency",    required_argument, 0, 'l'},
+	  {"maxbuffer",  required_argument, 0, 'b'},
+	  {"contbuffer", required_argument, 0, 'c'},
+	  {"help",       no_argument,       0, 'h'},
+	  {0, 0, 0, 0}
+	};
+      /* `getopt_long' stores the option index here. */
+      int option_index = 0;
+
+      // the + below tells getopt_long not to reorder argv
+      int c = getopt_long (argc, argv, "+t:l:b:c:h", longOptions, &option_index);
+
+      /* detect the end of the options */
+      if (c == -1)
+	break;
+
+      switch (c)
+	{
+	case 't':
+	  timestep = atof (optarg);
+	  continue;
+	case 'l':
+	  latency = atof (optarg);
+	  continue;
+	case 'b':
+	  maxbuffered = atoi (optarg);
+	  continue;
+	case 'c':
+	  contbuffered = atoi (optarg);
+	  continue;
+	case '?':
+	  break; // ignore unknown options
+	case 'h':
+	  usage (rank);
+
+	default:
+	  abort ();
+	}
+    }
+
+  if (argc < optind || argc > optind)
+    usage (rank);
+}
+
+int
+main (int argc, char *argv[])
+{
+  MUSIC::Setup* setup = new MUSIC::Setup (argc, argv);
+
+  MPI::Intracomm comm = setup->communicator ();
+  int nProcesses = comm.Get_size ();
+  int rank = comm.Get_rank ();
+  
+  getargs (rank, argc, argv);
+
+  MUSIC::EventOutputPort* out = setup->publishEventOutput ("out");
+  MUSIC::EventInputPort* in = setup->publishEventInput ("in");
+  MUSIC::ContInputPort* contdata = setup->publishContInput ("contdata");
+  if (!out->isConnected () && !in->isConnected ())
+    {
+      if (rank == 0)
+	std::cerr << "eventlag: no event port is connected" << std::endl;
+      comm.Abort (1);
+    }
+
+  bool receiving = in->isConnected ();
+  LagHandler handler;
+  int myFirst = 0;
+  int myWidth = 0;
+  if (out->isConnected ())
+    {
+      int localWidth = (out->width () - 1) / nProcesses + 1;
+      myFirst = rank * localWidth;
+      myWidth = std::max (0, std::min (localWidth, out->width () - myFirst));
+      MUSIC::LinearIndex indices (myFirst, myWidth);
+      out->map (&indices, MUSIC::Index::GLOBAL);
+    }
+  if (receiving)
+    {
+      int localWidth = (in->width () - 1) / nProcesses + 1;
+      int first = rank * localWidth;
+      int width = std::max (0, std::min (localWidth, in->width () - first));
+      MUSIC::LinearIndex indices (first, width);
+      in->map (&indices, &handler, latency, maxbuffered);
+    }
+  double* contarray = NULL;
+  if (contdata->isConnected ())
+    {
+      int localWidth = (contdata->width () - 1) / nProcesses + 1;
+      int first = rank * localWidth;
+      int width = std::max (0, std::min (localWidth,
+					  contdata->width () - first));
+      contarray = new double[std::max (width, 1)];
+      MUSIC::ArrayData dmap (contarray, MPI::DOUBLE, first, width);
+      contdata->map (&dmap, contbuffered);
+    }
+
+  double stoptime;
+  setup->config ("stoptime", &stoptime);
+
+  runtime = new MUSIC::Runtime (setup, timestep);
+
+  for (; runtime->time () < stoptime; runtime->tick ())
+    for (int i = 0; i < myWidth; ++i)
+      out->insertEvent (runtime->time (), MUSIC::GlobalIndex (myFirst + i));
+
+  runtime->finalize ();
+
+  delete runtime;
+  delete[] contarray;
+
+  // Events are delivered at the latest at the first tick after
+  // their time plus the acceptable latency
+  if (receiving)
+    {
+      std::cout << "eventlag: rank " << rank << " received " << nReceived
+		<< " events, maximal lag " << maxLag << " s" << std::endl;
+      if (maxLag > latency + timestep * 1.5)
+	{
+	  std::cerr << "eventlag: events arrived late" << std::endl;
+	  return 1;
+	}
+    }
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Leave as first include---required by BG/L
+#include <mpi.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+extern "C" {
+#include <unistd.h>
+#include <getopt.h>
+}
+
+#include <music.hh>
+
+// setupbench measures the time spent in the Runtime constructor,
+// which is dominated by spatial negotiation for wide ports and
+// large numbers of processes.  The same program is used on both
+// sides of a cont port pair.
+
+void
+usage (int rank)
+{
+  if (rank == 0)
+    {
+      std::cerr << "Usage: setupbench [OPTION...]" << std::endl
+		<< "`setupbench' reports the time needed to set up a cont port"
+		<< std::endl << "named out or in." << std::endl << std::endl
+		<< "  -m, --imaptype TYPE     linear (default) or roundrobin"
+		<< std::endl
+		<< "  -h, --help              print this help message"
+		<< std::endl << std::endl
+		<< "Report bugs to <music-bugs@incf.org>." << std::endl;
+    }
+  exit (1);
+}
+
+std::string imaptype = "linear";
+
+void
+getargs (int rank, int argc, char* argv[])
+{
+  opterr = 0; // handle errors ourselves
+  while (1)
+    {
+      static struct option longOptions[] =
+	{
+	  {"imaptype",    required_argument, 0, 'm'},
+	  {"help",        no_argument,       0, 'h'},
+	  {0, 0, 0, 0}
+	};
+      /* `getopt_long' stores the option index here. */
+      int option_index = 0;
+
+      // the + below tells getopt_long not to reorder argv
+      int c = getopt_long (argc, argv, "+m:h",
+			   longOptions, &option_index);
+
+      /* detect the end of the options */
+      if (c == -1)
+	break;
+
+      switch (c)
+	{
+	case 'm':
+	  imaptype = optarg;
+	  if (imaptype != "linear" && imaptype != "roundrobin")
+	    usage (rank);
+	  continue;
+	case '?':
+	  break; // ignore unknown options
+	case 'h':
+	  usage (rank);
+
+	default:
+	  abort ();
+	}
+    }
+
+  if (argc != optind)
+    usage (rank);
+}
+
+int
+main (int argc, char* argv[])
+{
+  MUSIC::Setup* setup = new MUSIC::Setup (argc, argv);
+
+  MPI::Intracomm comm = setup->communicator ();
+  int nProcesses = comm.Get_size ();
+  int rank = comm.Get_rank ();
+
+  getargs (rank, argc, argv);
+
+  MUSIC::ContOutputPort* out = setup->publishContOutput ("out");
+  MUSIC::ContInputPort* in = setup->publishContInput ("in");
+  MUSIC::ContPort* port = out;
+  std::string direction = "out";
+  if (!out->isConnected ())
+    {
+      port = in;
+      direction = "in";
+    }
+  if (!port->isConnected ())
+    {
+      if (rank == 0)
+	std::cerr << "setupbench: no port is connected" << std::endl;
+      comm.Abort (1);
+    }
+
+  int width = port->width ();
+  MUSIC::IndexMap* map;
+  int nLocal;
+  if (imaptype == "linear")
+    {
+      int nPerProcess = (width - 1) / nProcesses + 1;
+      int first = std::min (width, rank * nPerProcess);
+      nLocal = std::min (width, first + nPerProcess) - first;
+      map = new MUSIC::LinearIndex (first, nLocal);
+    }
+  else
+    {
+      std::vector<MUSIC::GlobalIndex> indices;
+      for (int i = rank; i < width; i += nProcesses)
+	indices.push_back (i);
+      nLocal = indices.size ();
+      map = new MUSIC::PermutationIndex (&indices[0], nLocal);
+    }
+  std::vector<double> data (nLocal + 1);
+
+  MUSIC::ArrayData dmap (&data[0], MPI::DOUBLE, map);
+  if (out->isConnected ())
+    out->map (&dmap);
+  else
+    in->map (&dmap);
+
+  comm.Barrier ();
+  double start = MPI::Wtime ();
+  MUSIC::Runtime* runtime = new MUSIC::Runtime (setup, 1e-3);
+  double elapsed = MPI::Wtime () - start;
+
+  double maxElapsed;
+  comm.Reduce (&elapsed, &maxElapsed, 1, MPI::DOUBLE, MPI::MAX, 0);
+  if (rank == 0)
+    std::cout << "setupbench: " << direction
+	      << " np=" << nProcesses
+	      << " width=" << width
+	      << " imaptype=" << imaptype
+	      << " setup time " << maxElapsed << " s" << std::endl;
+
+  runtime->finalize ();
+
+  delete runtime;
+  delete map;
+
+  return 0;
+}
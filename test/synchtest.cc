@@ -0,0 +1,99 @@
+/*
+ *  This file is part of MUSIC.
+ *  Copyright (C) 2011 INCF
+ *
+ *  MUSIC is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  MUSIC is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Leave as first include---required by BG/L
+#include <mpi.h>
+
+#include <iostream>
+
+#include <music/synchronizer.hh>
+
+// Checks that Synchronizer::nextCommunication computes the same
+// communication schedule as the tick-by-tick reference algorithm
+// for a range of tick interval ratios, latencies and buffer sizes.
+
+const int N_COMMUNICATIONS = 50;
+
+class TestSynchronizer : public MUSIC::Synchronizer {
+public:
+  TestSynchronizer (MUSIC::Clock* localTime,
+		    MUSIC::ClockState senderTickInterval,
+		    MUSIC::ClockState receiverTickInterval,
+		    MUSIC::ClockState latency,
+		    int maxBuffered)
+  {
+    setLocalTime (localTime);
+    setSenderTickInterval (senderTickInterval);
+    setReceiverTickInterval (receiverTickInterval);
+    setAccLatency (latency);
+    setMaxBuffered (maxBuffered);
+  }
+
+  // Returns the index of the first communication where the two
+  // algorithms differ, or -1
+  int
+  compare ()
+  {
+    MUSIC::Clock send = nextSend;
+    MUSIC::Clock receive = nextReceive;
+    for (int i = 0; i < N_COMMUNICATIONS; ++i)
+      {
+	nextCommunicationByTicks (send, receive);
+	nextCommunication (nextSend, nextReceive);
+	if (!(send == nextSend) || !(receive == nextReceive))
+	  return i;
+      }
+    return -1;
+  }
+};
+
+
+int
+main (int argc, char* argv[])
+{
+  MUSIC::Clock localTime (1e-9, 1e-3);
+  int nCases = 0;
+  int nFailures = 0;
+  for (int sti = 1; sti <= 12; ++sti)
+    for (int rti = 1; rti <= 12; ++rti)
+      for (int latency = -3 * 12; latency <= 5 * 12; ++latency)
+	for (int maxBuffered = 0; maxBuffered <= 4; ++maxBuffered)
+	  {
+	    // Scale tick intervals so that ratios are not all integral
+	    TestSynchronizer synch (&localTime,
+				    7 * sti,
+				    5 * rti,
+				    latency,
+				    maxBuffered);
+	    int i = synch.compare ();
+	    if (i >= 0)
+	      {
+		if (nFailures < 10)
+		  std::cerr << "synchtest: mismatch at communication " << i
+			    << " for sender tick " << 7 * sti
+			    << ", receiver tick " << 5 * rti
+			    << ", latency " << latency
+			    << ", maxBuffered " << maxBuffered << std::endl;
+		++nFailures;
+	      }
+	    ++nCases;
+	  }
+  std::cout << "synchtest: " << nCases - nFailures << " of " << nCases
+	    << " cases agree" << std::endl;
+  return nFailures > 0;
+}